@@ -45,6 +45,8 @@ ttest(recv_reorder)
 ttest(recv_reorder_more)
 ttest(recv_close)
 ttest(recv_special)
+ttest(recv_gro)
+ttest(recv_sws)
 
 ttest(send_connect)
 ttest(send_transmit)
@@ -53,6 +55,26 @@ ttest(send_window)
 ttest(send_ack)
 ttest(send_close)
 ttest(send_extra)
+ttest(send_mss)
+ttest(send_trim)
+ttest(send_nagle)
+ttest(send_pacing)
+ttest(send_gso)
+ttest(send_rack)
+ttest(send_frto)
+ttest(send_ecn)
+ttest(send_persist)
+ttest(peer_ack)
+ttest(peer_autotune)
+ttest(peer_ecn)
+ttest(peer_tfo)
+ttest(peer_metrics)
+ttest(peer_deadline)
+ttest(peer_info)
+ttest(tcp_manager)
+ttest(tcp_sharded)
+ttest(shared_memory_bridge)
+ttest(tcp_async)
 
 ttest(net_interface)
 
@@ -90,3 +112,5 @@ set_tests_properties(${compile_name_opt} PROPERTIES FIXTURES_SETUP compile_opt)
 
 stest(byte_stream_speed_test)
 stest(reassembler_speed_test)
+stest(tcp_shard_speed_test)
+stest(tcp_pingpong_speed_test)
@@ -1,9 +1,17 @@
 #include "byte_stream.hh"
 
+#include <algorithm>
+
 using namespace std;
 
 ByteStream::ByteStream( uint64_t capacity ) : capacity_( capacity ) {}
 
+void ByteStream::set_capacity( uint64_t capacity )
+{
+  // 已经缓冲的字节不能丢，容量最少要能装下它们
+  capacity_ = max( capacity, total_buffered_ );
+}
+
 bool Writer::is_closed() const
 {
   // Your code here.
@@ -25,7 +33,7 @@ void Writer::push( string data )
   total_pushed_ += data.size();
   total_buffered_ += data.size();
   // 将数据移动到流中
-  stream_.emplace( move( data ) );
+  stream_.emplace_back( move( data ) );
 }
 
 void Writer::close()
@@ -72,6 +80,40 @@ string_view Reader::peek() const
                          : string_view { stream_.front() }.substr( removed_prefix_ );
 }
 
+void Reader::peek( uint64_t offset, uint64_t len, string& out ) const
+{
+  len = min( len, offset < total_buffered_ ? total_buffered_ - offset : 0 );
+  if ( len == 0 ) {
+    return;
+  }
+
+  // 找到包含 offset 的块。新数据在尾部、重传的数据在头部，所以从离得近的一端找，之后顺着块只走一遍
+  offset += removed_prefix_;
+  const uint64_t end { removed_prefix_ + total_buffered_ };
+  auto chunk { stream_.begin() };
+  uint64_t start {}; // chunk 的第一个字节在 stream_ 中的位置
+  if ( offset < end / 2 ) {
+    while ( start + chunk->size() <= offset ) {
+      start += chunk->size();
+      ++chunk;
+    }
+  } else {
+    chunk = stream_.end();
+    start = end;
+    do {
+      --chunk;
+      start -= chunk->size();
+    } while ( start > offset );
+  }
+
+  out.reserve( out.size() + len );
+  for ( uint64_t skip { offset - start }; len > 0; ++chunk, skip = 0 ) {
+    const string_view view { string_view { *chunk }.substr( skip, len ) };
+    out += view;
+    len -= view.size();
+  }
+}
+
 void Reader::pop( uint64_t len )
 {
   // Your code here.
@@ -87,7 +129,7 @@ void Reader::pop( uint64_t len )
       break; // with len = 0;
     }
     // 否则，弹出当前块并重置前缀
-    stream_.pop();
+    stream_.pop_front();
     removed_prefix_ = 0;
     len -= size;
   }
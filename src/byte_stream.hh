@@ -1,7 +1,7 @@
 #pragma once
 
 #include <cstdint>
-#include <queue>
+#include <deque>
 #include <string>
 #include <string_view>
 
@@ -22,10 +22,13 @@ public:
   void set_error() { error_ = true; };       // Signal that the stream suffered an error.
   bool has_error() const { return error_; }; // Has the stream had an error?
 
+  uint64_t capacity() const { return capacity_; } // Current capacity of the stream
+  void set_capacity( uint64_t capacity );         // Resize the stream (never below the bytes it holds)
+
 protected:
   // Please add any additional state to the ByteStream here, and not to the Writer and Reader interfaces.
   // 用于存储字节流的缓冲区，按顺序保存被推送的数据
-  std::queue<std::string> stream_ {};
+  std::deque<std::string> stream_ {};
   // 记录从流中弹出的前缀字节数
   uint64_t removed_prefix_ {};
   // 最大容量，限制字节流可占用的内存大小
@@ -57,6 +60,8 @@ class Reader : public ByteStream
 {
 public:
   std::string_view peek() const; // Peek at the next bytes in the buffer
+  // Append the buffered bytes [offset, offset + len) to `out` (as many as are buffered), leaving them buffered
+  void peek( uint64_t offset, uint64_t len, std::string& out ) const;
   void pop( uint64_t len );      // Remove `len` bytes from the buffer
 
   bool is_finished() const;        // Is the stream finished (closed and fully popped)?
@@ -97,8 +97,8 @@ private:
   // 检查 TTL 是否过期
   struct Timer
   {
-    size_t _ms {};
-    constexpr Timer& tick( const size_t& ms_since_last_tick ) noexcept
+    mutable size_t _ms {};
+    constexpr const Timer& tick( const size_t& ms_since_last_tick ) const noexcept
     {
       return _ms += ms_since_last_tick, *this;
     } // 更新时间
@@ -105,6 +105,18 @@ void Reassembler::insert( uint64_t first_index, string data, bool is_last_substr
   return try_close();
 }
 
+// 调整输出流的容量；缩小时丢弃落在新窗口之外的待组装字节
+void Reassembler::set_capacity( uint64_t capacity )
+{
+  output_.set_capacity( capacity );
+
+  const uint64_t unacceptable_index { writer().bytes_pushed() + writer().available_capacity() };
+  const auto beyond { split( unacceptable_index ) };
+  ranges::for_each( ranges::subrange( beyond, buf_.end() ) | views::values,
+                    [&]( const auto& str ) { total_pending_ -= str.size(); } );
+  buf_.erase( beyond, buf_.end() );
+}
+
 uint64_t Reassembler::bytes_pending() const
 {
   // 返回总待处理字节数
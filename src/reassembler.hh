@@ -37,6 +37,9 @@ public:
   // How many bytes are stored in the Reassembler itself?
   uint64_t bytes_pending() const;
 
+  // Resize the output stream (see ByteStream::set_capacity), discarding pending bytes that no longer fit
+  void set_capacity( uint64_t capacity );
+
   // Access output stream reader
   Reader& reader() { return output_.reader(); }
   const Reader& reader() const { return output_.reader(); }
@@ -30,6 +30,9 @@ void Router::add_route( const uint32_t route_prefix,
 // Go through all the interfaces, and route every incoming datagram to its proper outgoing interface.
 void Router::route()
 {
+   // 这一轮转发到每个接口的数据报个数，相当于该接口输出队列的长度
+   vector<size_t> backlog( _interfaces.size() );
+
    // 遍历所有网络接口
    for ( const auto& interface : _interfaces ) {
     auto&& datagrams_received { interface->datagrams_received() };
@@ -52,6 +55,15 @@ void Router::route()
         continue;
       }
       const auto& [num, next_hop] { mp.value() };
+
+      // 输出队列超过阈值：ECN-capable 的数据报标记为 CE，通知两端的 TCP 减速
+      backlog[num]++;
+      if ( ecn_threshold_ > 0 and backlog[num] > ecn_threshold_
+           and ( datagram.header.tos & IPv4Header::ECN_MASK ) != 0 ) {
+        datagram.header.tos |= IPv4Header::ECN_CE;
+        datagram.header.compute_checksum();
+      }
+
        // 将数据报发送到匹配的接口，如果有下一跳地址则使用它，否则使用数据报的目的地址
       _interfaces[num]->send_datagram( datagram,
                                        next_hop.value_or( Address::from_ipv4_numeric( datagram.header.dst ) ) );
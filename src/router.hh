@@ -40,9 +40,15 @@ public:
   // Route packets between the interfaces
   void route();
 
+  // 拥塞标记 (ECN, RFC 3168)：一轮 route() 中转发到同一个接口的数据报超过 datagrams 个时，
+  // 给之后的 ECN-capable 数据报打上 CE 标记（而不是等队列满了再丢弃）。0 表示不标记
+  void set_ecn_threshold( size_t datagrams ) { ecn_threshold_ = datagrams; }
+
 private:
   // The router's collection of network interfaces
   std::vector<std::shared_ptr<NetworkInterface>> _interfaces {};
+
+  size_t ecn_threshold_ {};
   
  // 路由表，存储了32个路由表项，每个表项是一个unordered_map
    using info = std::pair<size_t, std::optional<Address>>;
@@ -0,0 +1,282 @@
+#include "tcp_async.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+TCPAsyncTask::~TCPAsyncTask()
+{
+  if ( handle_ ) {
+    handle_.destroy();
+  }
+}
+
+void TCPAsyncTask::promise_type::unhandled_exception()
+{
+  if ( stack->error_ == nullptr ) {
+    stack->error_ = current_exception();
+  }
+}
+
+void TCPAsyncWaiter::await_suspend( coroutine_handle<> handle )
+{
+  handle_ = handle;
+  if ( waited_id_.has_value() ) {
+    stack_->waiting_[waited_id_.value()].push_back( this );
+  } else {
+    stack_->accepting_[waited_port_].push_back( this );
+  }
+}
+
+TCPAsyncConnection::ReadAwaiter::ReadAwaiter( TCPAsyncConnection& connection, string& buffer )
+  : TCPAsyncWaiter( *connection.stack_, connection.id_ ), connection_( connection ), buffer_( buffer )
+{}
+
+bool TCPAsyncConnection::ReadAwaiter::try_complete()
+{
+  TCPPeer* peer = stack_->manager_.find( connection_.id_ );
+  if ( peer == nullptr ) {
+    return true;
+  }
+  const Reader& inbound = peer->inbound_reader();
+  return inbound.bytes_buffered() > 0 or inbound.is_finished() or inbound.has_error();
+}
+
+size_t TCPAsyncConnection::ReadAwaiter::await_resume()
+{
+  TCPPeer* peer = stack_->manager_.find( connection_.id_ );
+  if ( peer == nullptr ) {
+    buffer_.clear(); // finished, and forgotten by the manager
+    return 0;
+  }
+  Reader& inbound = peer->inbound_reader();
+  if ( inbound.has_error() ) {
+    throw runtime_error( "read() from " + connection_.peer_address().to_string() + ": connection reset" );
+  }
+
+  if ( buffer_.empty() ) {
+    buffer_.resize( DEFAULT_READ_SIZE );
+  }
+  size_t len = 0;
+  while ( len < buffer_.size() and inbound.bytes_buffered() > 0 ) {
+    const string_view data = inbound.peek().substr( 0, buffer_.size() - len );
+    copy( data.begin(), data.end(), buffer_.begin() + static_cast<ptrdiff_t>( len ) );
+    inbound.pop( data.size() );
+    len += data.size();
+  }
+  buffer_.resize( len );
+  if ( len > 0 ) {
+    stack_->manager_.update_window( connection_.id_ );
+  }
+  return len;
+}
+
+TCPAsyncConnection::WriteAwaiter::WriteAwaiter( TCPAsyncConnection& connection, string_view data )
+  : TCPAsyncWaiter( *connection.stack_, connection.id_ ), connection_( connection ), data_( data )
+{}
+
+bool TCPAsyncConnection::WriteAwaiter::try_complete()
+{
+  TCPPeer* peer = stack_->manager_.find( connection_.id_ );
+  if ( peer == nullptr or peer->inbound_reader().has_error() or peer->outbound_writer().is_closed() ) {
+    return true;
+  }
+
+  // copy what fits now; the rest waits for the peer to acknowledge some of what is outstanding
+  Writer& outbound = peer->outbound_writer();
+  const uint64_t len = min<uint64_t>( data_.size(), outbound.available_capacity() );
+  if ( len > 0 ) {
+    outbound.push( string { data_.substr( 0, len ) } );
+    data_.remove_prefix( len );
+    stack_->manager_.push( connection_.id_ );
+  }
+  return data_.empty();
+}
+
+void TCPAsyncConnection::WriteAwaiter::await_resume()
+{
+  if ( not data_.empty() ) {
+    throw runtime_error( "write() to " + connection_.peer_address().to_string()
+                         + ": connection reset or closed" );
+  }
+}
+
+TCPAsyncConnection::TCPAsyncConnection( TCPAsyncConnection&& other ) noexcept
+  : stack_( exchange( other.stack_, nullptr ) ), id_( other.id_ )
+{}
+
+void TCPAsyncConnection::close()
+{
+  TCPPeer* peer = stack_->manager_.find( id_ );
+  if ( peer != nullptr and not peer->outbound_writer().is_closed() ) {
+    peer->outbound_writer().close();
+    stack_->manager_.push( id_ );
+  }
+}
+
+TCPAsyncConnection::~TCPAsyncConnection()
+{
+  if ( stack_ == nullptr ) {
+    return; // moved from
+  }
+  try {
+    close();
+    stack_->orphans_.push_back( id_ );
+  } catch ( const exception& e ) {
+    cerr << "Exception destructing TCPAsyncConnection: " << e.what() << endl;
+  }
+}
+
+bool TCPAsyncListener::AcceptAwaiter::try_complete()
+{
+  auto& accepted = stack_->manager_.accepted( port_ );
+  while ( not accepted.empty() ) {
+    id_ = accepted.front();
+    accepted.pop();
+    if ( stack_->manager_.find( id_ ) != nullptr ) {
+      return true;
+    }
+    // reset before anyone accepted it
+  }
+  return false;
+}
+
+TCPAsyncConnection TCPAsyncListener::AcceptAwaiter::await_resume()
+{
+  return { *stack_, id_ };
+}
+
+bool TCPAsyncStack::ConnectAwaiter::try_complete()
+{
+  TCPPeer* peer = stack_->manager_.find( id_ );
+  return peer == nullptr or peer->has_ackno() or peer->inbound_reader().has_error();
+}
+
+TCPAsyncConnection TCPAsyncStack::ConnectAwaiter::await_resume()
+{
+  TCPPeer* peer = stack_->manager_.find( id_ );
+  if ( peer == nullptr or peer->inbound_reader().has_error() ) {
+    const Address remote { Address::from_ipv4_numeric( id_.remote_ip ).ip(), id_.remote_port };
+    throw runtime_error( "connect() to " + remote.to_string() + " failed" );
+  }
+  return { *stack_, id_ };
+}
+
+TCPAsyncStack::TCPAsyncStack( FileDescriptor&& device, const TCPConfig& cfg )
+  : device_( std::move( device ) ), manager_( cfg )
+{
+  manager_.install_rules( eventloop_, device_ );
+  manager_.on_activity( [this]( const FourTuple& id ) { active_.insert( id ); } );
+}
+
+TCPAsyncListener TCPAsyncStack::listen( uint16_t port, size_t syn_backlog, size_t accept_backlog )
+{
+  manager_.listen( port, syn_backlog, accept_backlog );
+  return { *this, port };
+}
+
+TCPAsyncStack::ConnectAwaiter TCPAsyncStack::connect( const Address& local, const Address& remote )
+{
+  return { *this, manager_.connect( local, remote ) };
+}
+
+void TCPAsyncStack::spawn( TCPAsyncTask task )
+{
+  const auto handle = exchange( task.handle_, {} );
+  handle.promise().stack = this;
+  tasks_.insert( handle.address() );
+  handle.resume();
+}
+
+void TCPAsyncStack::finish( coroutine_handle<> task )
+{
+  tasks_.erase( task.address() );
+  task.destroy();
+}
+
+void TCPAsyncStack::run()
+{
+  auto base_time = timestamp_ms();
+  resume_ready();
+
+  // once every coroutine has returned, stay to close the connections (retransmitting FINs, and lingering)
+  while ( error_ == nullptr and ( not tasks_.empty() or manager_.size() > 0 ) ) {
+    eventloop_.wait_next_event( poll_timeout_ms( manager_.ms_until_next_tick() ) );
+    const auto next_time = timestamp_ms();
+    manager_.tick( next_time - base_time );
+    base_time = next_time;
+    drain_orphans();
+    resume_ready();
+  }
+
+  if ( error_ != nullptr ) {
+    rethrow_exception( exchange( error_, nullptr ) );
+  }
+}
+
+void TCPAsyncStack::resume_ready()
+{
+  // only an operation on a connection the manager has acted on (or on its port, for an accept) can have become
+  // ready; a resumed coroutine may act on connections in turn, so go round until none has been
+  while ( not active_.empty() ) {
+    const auto active = exchange( active_, {} );
+    for ( const FourTuple& id : active ) {
+      resume_ready( waiting_, id );
+      resume_ready( accepting_, id.local_port );
+    }
+  }
+}
+
+template<class Key, class Map>
+void TCPAsyncStack::resume_ready( Map& waiting, const Key& key )
+{
+  const auto it = waiting.find( key );
+  if ( it == waiting.end() ) {
+    return;
+  }
+
+  // a resumed coroutine may wait on the same key again, so set the list aside while going through it (a
+  // reference to a map entry stays valid when other keys are added)
+  Waiters& waiters = it->second;
+  for ( TCPAsyncWaiter* waiter : exchange( waiters, {} ) ) {
+    if ( waiter->try_complete() ) {
+      waiter->handle_.resume(); // (this may free the waiter)
+    } else {
+      waiters.push_back( waiter );
+    }
+  }
+  if ( waiters.empty() ) {
+    waiting.erase( key );
+  }
+}
+
+void TCPAsyncStack::drain_orphans()
+{
+  erase_if( orphans_, [this]( const FourTuple& id ) {
+    TCPPeer* peer = manager_.find( id );
+    if ( peer == nullptr ) {
+      return true;
+    }
+    Reader& inbound = peer->inbound_reader();
+    if ( inbound.bytes_buffered() > 0 ) {
+      inbound.pop( inbound.bytes_buffered() );
+      manager_.update_window( id );
+    }
+    return false;
+  } );
+}
+
+TCPAsyncStack::~TCPAsyncStack()
+{
+  waiting_.clear();
+  accepting_.clear();
+  for ( void* task : tasks_ ) {
+    coroutine_handle<>::from_address( task ).destroy();
+  }
+}
@@ -0,0 +1,324 @@
+#include "tcp_connection_manager.hh"
+
+#include "parser.hh"
+#include "tcp_fastopen.hh"
+#include "tcp_metrics.hh"
+#include "tcp_over_ip.hh"
+#include "tuntap_adapter.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+size_t FourTupleHash::operator()( const FourTuple& id ) const noexcept
+{
+  // splitmix64's finalizer over both endpoints, so flows that differ in any field land far apart
+  uint64_t x = ( static_cast<uint64_t>( id.local_ip ) << 32 | id.remote_ip )
+               ^ ( static_cast<uint64_t>( id.local_port ) << 16 | id.remote_port ) * 0x9e3779b97f4a7c15;
+  x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9;
+  x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111eb;
+  return x ^ ( x >> 31 );
+}
+
+FourTuple TCPConnectionManager::connect( const Address& local, const Address& remote )
+{
+  const FourTuple id { local.ipv4_numeric(), local.port(), remote.ipv4_numeric(), remote.port() };
+  if ( connections_.contains( id ) ) {
+    throw runtime_error( "connect() to a 4-tuple already in use: " + local.to_string() + " -> "
+                         + remote.to_string() );
+  }
+
+  TCPConfig cfg = cfg_;
+  if ( cfg.fastopen and not cfg.fastopen_cookie.has_value() ) {
+    cfg.fastopen_cookie = cached_fastopen_cookie( remote );
+  }
+  if ( not cfg.metrics.has_value() ) {
+    cfg.metrics = cached_tcp_metrics( remote );
+  }
+
+  Connection& connection = open( id, cfg );
+  connection.peer.push( connection.transmit );
+  schedule( id, connection );
+  return id;
+}
+
+void TCPConnectionManager::listen( uint16_t port, size_t syn_backlog, size_t accept_backlog )
+{
+  listeners_.insert_or_assign( port, Listener { .syn_backlog = syn_backlog, .accept_backlog = accept_backlog } );
+}
+
+TCPPeer* TCPConnectionManager::find( const FourTuple& id )
+{
+  const auto it = connections_.find( id );
+  return it == connections_.end() ? nullptr : &it->second.peer;
+}
+
+void TCPConnectionManager::push( const FourTuple& id )
+{
+  const auto it = connections_.find( id );
+  if ( it != connections_.end() ) {
+    catch_up( it->second );
+    it->second.peer.push( it->second.transmit );
+    schedule( id, it->second );
+  }
+}
+
+void TCPConnectionManager::update_window( const FourTuple& id )
+{
+  const auto it = connections_.find( id );
+  if ( it != connections_.end() ) {
+    catch_up( it->second );
+    it->second.peer.update_window( it->second.transmit );
+    schedule( id, it->second );
+  }
+}
+
+void TCPConnectionManager::receive( const InternetDatagram& dgram )
+{
+  auto seg = TCPOverIPv4Adapter::parse_tcp_in_ip( dgram );
+  if ( not seg.has_value() ) {
+    return;
+  }
+
+  const FourTuple id { dgram.header.dst, seg->udinfo.dst_port, dgram.header.src, seg->udinfo.src_port };
+  auto it = connections_.find( id );
+  if ( it == connections_.end() ) {
+    const TCPMessage& msg = seg->message;
+    const bool connecting = msg.sender.SYN and not msg.sender.RST and not msg.receiver.ackno.has_value();
+    const auto listener = listeners_.find( id.local_port );
+    if ( not connecting or listener == listeners_.end() ) {
+      reset( id, msg );
+      return;
+    }
+    if ( listener->second.syn_queue.size() >= listener->second.syn_backlog ) {
+      return; // SYN queue full: the client will try again
+    }
+
+    // Passive open: the client's SYN gives its address, which its Fast Open cookie and cached metrics go by
+    const Address client = Address::from_ipv4_numeric( id.remote_ip );
+    Connection& connection = open( id, cfg_ );
+    connection.peer.issue_fastopen_cookie( fastopen_cookie_for( client ) );
+    if ( const auto metrics = cached_tcp_metrics( client ) ) {
+      connection.peer.seed_metrics( metrics.value() );
+    }
+    connection.half_open = true;
+    listener->second.syn_queue.push_back( id );
+    it = connections_.find( id );
+  }
+
+  Connection& connection = it->second;
+  catch_up( connection );
+  connection.peer.receive( std::move( seg->message ), connection.transmit );
+  if ( connection.half_open ) {
+    try_accept( id, connection );
+  }
+  schedule( id, connection );
+}
+
+void TCPConnectionManager::tick( uint64_t ms_since_last_tick )
+{
+  now_ms_ += ms_since_last_tick;
+
+  // The connections whose deadline has come, and the ones that are checked on every tick
+  vector<FourTuple> due { polled_.begin(), polled_.end() };
+  while ( not timers_.empty() and timers_.top().due_ms <= now_ms_ ) {
+    const Timer timer = timers_.top();
+    timers_.pop();
+    if ( not stale( timer ) ) {
+      connections_.at( timer.id ).deadline_ms.reset();
+      due.push_back( timer.id );
+    }
+  }
+
+  for ( const FourTuple& id : due ) {
+    const auto it = connections_.find( id );
+    if ( it == connections_.end() ) {
+      continue; // listed twice, and already dropped
+    }
+    Connection& connection = it->second;
+    TCPPeer& peer = connection.peer;
+    catch_up( connection );
+
+    bool done = false;
+    if ( connection.half_open and not try_accept( id, connection ) ) {
+      // The accept queue may be full; otherwise give up on a handshake that does not complete
+      done = not peer.active() or peer.sender().consecutive_retransmissions() > TCPConfig::MAX_RETX_ATTEMPTS;
+    } else {
+      const Reader& inbound = peer.inbound_reader();
+      done = not peer.active() and ( inbound.is_finished() or inbound.has_error() );
+    }
+    if ( not done ) {
+      schedule( id, connection );
+      continue;
+    }
+
+    if ( connection.half_open ) {
+      std::erase( listeners_.at( id.local_port ).syn_queue, id );
+    }
+    if ( const auto metrics = peer.sender().metrics() ) {
+      cache_tcp_metrics( Address::from_ipv4_numeric( id.remote_ip ), metrics.value() );
+    }
+    polled_.erase( id );
+    connections_.erase( it );
+    if ( on_activity_ ) {
+      on_activity_( id );
+    }
+  }
+  drop_stale_timers();
+}
+
+optional<uint64_t> TCPConnectionManager::ms_until_next_tick() const
+{
+  // Every operation ends by dropping stale entries from the top of the heap, so the top is live
+  if ( timers_.empty() ) {
+    return nullopt;
+  }
+  return timers_.top().due_ms > now_ms_ ? timers_.top().due_ms - now_ms_ : 0;
+}
+
+void TCPConnectionManager::install_rules( EventLoop& loop, FileDescriptor& tun )
+{
+  tun.set_blocking( false );
+
+  loop.add_rule( "demultiplex datagrams from the TUN device", tun, Direction::In, [this, &tun] {
+    for ( size_t i = 0; i < TCPOverIPv4OverTunFdAdapter::GRO_MAX_BURST; i++ ) {
+      vector<string> strs( 2 );
+      strs.front().resize( IPv4Header::LENGTH );
+      tun.read( strs );
+      if ( strs.empty() ) {
+        break; // nothing more waiting on the (non-blocking) device
+      }
+
+      InternetDatagram dgram;
+      const vector<string> buffers = { strs.at( 0 ), strs.at( 1 ) };
+      if ( parse( dgram, buffers ) ) {
+        receive( dgram );
+      }
+    }
+  } );
+
+  loop.add_rule(
+    "write datagrams to the TUN device",
+    tun,
+    Direction::Out,
+    [this, &tun] {
+      while ( not datagrams_out_.empty() ) {
+        if ( tun.write( serialize( datagrams_out_.front() ) ) == 0 ) {
+          break; // the (non-blocking) device is full: the rest waits until it is writable again
+        }
+        datagrams_out_.pop();
+      }
+    },
+    [this] { return not datagrams_out_.empty(); } );
+}
+
+TCPConnectionManager::Connection& TCPConnectionManager::open( const FourTuple& id, const TCPConfig& cfg )
+{
+  Connection& connection
+    = connections_.emplace( piecewise_construct, forward_as_tuple( id ), forward_as_tuple( cfg ) ).first->second;
+  connection.transmit = [this, id]( const TCPMessage& msg ) { send( id, msg ); };
+  connection.ticked_ms = now_ms_;
+  return connection;
+}
+
+// Give a connection the time that has passed since it was last ticked (before anything else happens to it)
+void TCPConnectionManager::catch_up( Connection& connection )
+{
+  if ( connection.ticked_ms < now_ms_ ) {
+    connection.peer.tick( now_ms_ - connection.ticked_ms, connection.transmit );
+    connection.ticked_ms = now_ms_;
+  }
+}
+
+// After something has happened to a connection: put its next deadline in the timer heap (the entry for an
+// earlier one goes stale), and check it on every tick while it waits on the application rather than on time,
+// i.e. while it is finished but not yet read to the end, or established but not yet in a full accept queue
+void TCPConnectionManager::schedule( const FourTuple& id, Connection& connection )
+{
+  const TCPPeer& peer = connection.peer;
+  optional<uint64_t> deadline;
+  if ( const auto ms = peer.ms_until_next_tick() ) {
+    deadline = now_ms_ + ms.value();
+  }
+  if ( deadline.has_value() and deadline != connection.deadline_ms ) {
+    timers_.push( { deadline.value(), id } );
+  }
+  connection.deadline_ms = deadline;
+
+  if ( not peer.active() or ( connection.half_open and peer.established() ) ) {
+    polled_.insert( id );
+  } else {
+    polled_.erase( id );
+  }
+  drop_stale_timers();
+
+  if ( on_activity_ ) {
+    on_activity_( id );
+  }
+}
+
+bool TCPConnectionManager::stale( const Timer& timer ) const
+{
+  const auto it = connections_.find( timer.id );
+  return it == connections_.end() or it->second.deadline_ms != timer.due_ms;
+}
+
+// Pop stale entries off the top, and rebuild the heap once they make up most of it
+void TCPConnectionManager::drop_stale_timers()
+{
+  while ( not timers_.empty() and stale( timers_.top() ) ) {
+    timers_.pop();
+  }
+  if ( timers_.size() > 2 * connections_.size() + 64 ) {
+    decltype( timers_ ) live;
+    for ( const auto& [id, connection] : connections_ ) {
+      if ( connection.deadline_ms.has_value() ) {
+        live.push( { connection.deadline_ms.value(), id } );
+      }
+    }
+    timers_ = std::move( live );
+  }
+}
+
+// Move a half-open connection whose handshake has completed to its listener's accept queue, if there is room
+bool TCPConnectionManager::try_accept( const FourTuple& id, Connection& connection )
+{
+  Listener& listener = listeners_.at( id.local_port );
+  if ( not connection.peer.established() or listener.accept_queue.size() >= listener.accept_backlog ) {
+    return false;
+  }
+  connection.half_open = false;
+  std::erase( listener.syn_queue, id );
+  listener.accept_queue.push( id );
+  return true;
+}
+
+void TCPConnectionManager::send( const FourTuple& id, const TCPMessage& msg )
+{
+  // The wire has no segmentation offload: cut super-segments up here, as the TUN adapter does
+  for ( const auto& piece : split_gso( msg ) ) {
+    datagrams_out_.push(
+      TCPOverIPv4Adapter::make_tcp_in_ip( piece, id.local_ip, id.local_port, id.remote_ip, id.remote_port ) );
+  }
+}
+
+// RFC 9293 3.10.7.1: a segment for no connection is answered with a RST that the sender will accept
+void TCPConnectionManager::reset( const FourTuple& id, const TCPMessage& msg )
+{
+  if ( msg.sender.RST ) {
+    return;
+  }
+
+  TCPMessage rst;
+  rst.sender.RST = true;
+  if ( msg.receiver.ackno.has_value() ) {
+    rst.sender.seqno = msg.receiver.ackno.value();
+  } else {
+    rst.receiver.ackno = msg.sender.seqno + msg.sender.sequence_length();
+  }
+  send( id, rst );
+}
@@ -0,0 +1,184 @@
+#include "tcp_minnow_listener.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+TCPMinnowListener::TCPMinnowListener( TunFD&& tun,
+                                      const TCPConfig& cfg,
+                                      uint16_t port,
+                                      size_t syn_backlog,
+                                      size_t accept_backlog )
+  : _tun( std::move( tun ) ), _port( port ), _manager( cfg )
+{
+  _manager.listen( _port, syn_backlog, accept_backlog );
+  _manager.install_rules( _eventloop, _tun );
+  _push_category = _eventloop.add_category( "push bytes to TCPPeer" );
+  _pull_category = _eventloop.add_category( "read bytes from inbound stream" );
+  _eventloop.add_rule( "wake the TCP thread", _wakeup, Direction::In, [this] { _wakeup.clear(); } );
+
+  cerr << "DEBUG: minnow listening on port " << _port << "...\n";
+  _tcp_thread = thread( &TCPMinnowListener::_tcp_main, this );
+}
+
+TCPMinnowConnection TCPMinnowListener::accept()
+{
+  unique_lock lock( _mutex );
+  _accepts_waiting++;
+  _wakeup.notify(); // an established connection may be waiting for an accept()
+  _ready_cv.wait( lock, [&] { return not _ready.empty() or _abort; } );
+  _accepts_waiting--;
+  if ( _ready.empty() ) {
+    throw runtime_error( "accept() on a listener that is shutting down" );
+  }
+
+  TCPMinnowConnection connection = std::move( _ready.front() );
+  _ready.pop();
+  cerr << "DEBUG: minnow new connection from " << connection.peer_address().to_string() << ".\n";
+  return connection;
+}
+
+TCPMinnowListener::~TCPMinnowListener()
+{
+  {
+    const lock_guard lock( _mutex );
+    _abort = true;
+  }
+  _ready_cv.notify_all();
+  _wakeup.notify();
+  if ( _tcp_thread.joinable() ) {
+    _tcp_thread.join();
+  }
+}
+
+void TCPMinnowListener::_tcp_main()
+{
+  try {
+    auto base_time = timestamp_ms();
+    while ( not _abort ) {
+      _eventloop.wait_next_event( poll_timeout_ms( _manager.ms_until_next_tick() ) );
+      const auto next_time = timestamp_ms();
+      _manager.tick( next_time - base_time );
+      base_time = next_time;
+      _hand_over_accepted();
+      _sweep_bridges();
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception in TCPMinnowListener thread: " << e.what() << "\n";
+    throw e;
+  }
+}
+
+void TCPMinnowListener::_hand_over_accepted()
+{
+  const lock_guard lock( _mutex );
+  auto& accepted = _manager.accepted( _port );
+  bool handed_over = false;
+  while ( _accepts_waiting > _ready.size() and not accepted.empty() ) {
+    const FourTuple id = accepted.front();
+    accepted.pop();
+    if ( _manager.find( id ) == nullptr ) {
+      continue; // reset before anyone accepted it
+    }
+
+    auto [owner_data, thread_data] = socket_pair_helper<LocalStreamSocket>( AF_UNIX, SOCK_STREAM );
+    thread_data.set_blocking( false );
+    _bridge( id, std::move( thread_data ) );
+    _ready.emplace( std::move( owner_data ),
+                    Address { Address::from_ipv4_numeric( id.remote_ip ).ip(), id.remote_port } );
+    handed_over = true;
+  }
+  if ( handed_over ) {
+    _ready_cv.notify_all();
+  }
+}
+
+void TCPMinnowListener::_bridge( const FourTuple& id, LocalStreamSocket&& thread_data )
+{
+  Bridge& bridge = _bridges.emplace_back( Bridge { .id = id, .thread_data = std::move( thread_data ) } );
+
+  // read from the owner's writes into the outbound stream
+  bridge.rules.push_back( _eventloop.add_rule(
+    _push_category,
+    bridge.thread_data,
+    Direction::In,
+    [this, &bridge] {
+      TCPPeer& peer = *_manager.find( bridge.id );
+      string data;
+      data.resize( peer.outbound_writer().available_capacity() );
+      bridge.thread_data.read( data );
+      peer.outbound_writer().push( std::move( data ) );
+      if ( bridge.thread_data.eof() ) {
+        peer.outbound_writer().close();
+        bridge.outbound_shutdown = true;
+      }
+      _manager.push( bridge.id );
+    },
+    [this, &bridge] {
+      TCPPeer* peer = _manager.find( bridge.id );
+      return peer != nullptr and peer->active() and not bridge.outbound_shutdown
+             and peer->outbound_writer().available_capacity() > 0;
+    },
+    [this, &bridge] {
+      if ( TCPPeer* peer = _manager.find( bridge.id ) ) {
+        peer->outbound_writer().close();
+        _manager.push( bridge.id );
+      }
+      bridge.outbound_shutdown = true;
+    },
+    [this, &bridge] {
+      if ( TCPPeer* peer = _manager.find( bridge.id ) ) {
+        peer->outbound_writer().set_error();
+      }
+    } ) );
+
+  // write the inbound stream to the owner
+  bridge.rules.push_back( _eventloop.add_rule(
+    _pull_category,
+    bridge.thread_data,
+    Direction::Out,
+    [this, &bridge] {
+      Reader& inbound = _manager.find( bridge.id )->inbound_reader();
+      if ( inbound.bytes_buffered() ) {
+        inbound.pop( bridge.thread_data.write( inbound.peek() ) );
+        _manager.update_window( bridge.id );
+      }
+      if ( inbound.is_finished() or inbound.has_error() ) {
+        bridge.thread_data.shutdown( SHUT_WR );
+        bridge.inbound_shutdown = true;
+      }
+    },
+    [this, &bridge] {
+      TCPPeer* peer = _manager.find( bridge.id );
+      if ( peer == nullptr ) {
+        return false;
+      }
+      const Reader& inbound = peer->inbound_reader();
+      return inbound.bytes_buffered() > 0
+             or ( ( inbound.is_finished() or inbound.has_error() ) and not bridge.inbound_shutdown );
+    },
+    [] {},
+    [this, &bridge] {
+      if ( TCPPeer* peer = _manager.find( bridge.id ) ) {
+        peer->inbound_reader().set_error();
+      }
+    } ) );
+}
+
+void TCPMinnowListener::_sweep_bridges()
+{
+  for ( auto it = _bridges.begin(); it != _bridges.end(); ) {
+    if ( _manager.find( it->id ) != nullptr ) {
+      ++it;
+      continue;
+    }
+    for ( auto& rule : it->rules ) {
+      rule.cancel();
+    }
+    it = _bridges.erase( it ); // closing our end gives the owner EOF
+  }
+}
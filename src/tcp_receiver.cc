@@ -1,4 +1,7 @@
 #include "tcp_receiver.hh"
+#include "ipv4_header.hh"
+
+#include <algorithm>
 
 using namespace std;
 
@@ -17,7 +20,8 @@ void TCPReceiver::receive( TCPSenderMessage message )
   }
 
   // 如果没有设置 zero_point，且接收到的消息中没有 SYN 标志，返回
-  if ( not zero_point_.has_value() ) {
+  const bool first { not zero_point_.has_value() };
+  if ( first ) {
     if ( not message.SYN ) {
       return;
     }
@@ -25,10 +29,26 @@ void TCPReceiver::receive( TCPSenderMessage message )
     zero_point_.emplace( message.seqno );
   }
 
+  // ECN：对方减了窗口就停止回显；路由器标记了拥塞就开始回显（同一个段两者都有时，以 CE 为准）
+  if ( ecn_ ) {
+    ece_ = ece_ and not message.CWR;
+    ece_ = ece_ or message.ecn == IPv4Header::ECN_CE;
+  }
+
+  // 缓冲区正在缩小：对方已经用掉的那部分窗口不再需要保留
+  shrink();
+
   // 计算绝对序列号
   const uint64_t checkpoint { writer().bytes_pushed() + 1 /* SYN */ }; // 计算期待的负载的绝对序列号
   const uint64_t absolute_seqno { message.seqno.unwrap( zero_point_.value(), checkpoint ) };
 
+  // 统计重复的段（只带着已经确认过的序列号）和乱序的段（起点越过了下一个期待的序列号）
+  const uint64_t expected { checkpoint + static_cast<uint64_t>( writer().is_closed() ) };
+  if ( not first and message.sequence_length() > 0 ) {
+    duplicate_segments_ += absolute_seqno + message.sequence_length() <= expected;
+    out_of_order_segments_ += absolute_seqno > expected;
+  }
+
   // 计算流索引
   const uint64_t stream_index { absolute_seqno + static_cast<uint64_t>( message.SYN ) - 1 /* SYN */ };
 
@@ -40,17 +60,64 @@ void TCPReceiver::receive( TCPSenderMessage message )
 TCPReceiverMessage TCPReceiver::send() const
 {
   // 计算窗口大小，确保不超过 UINT16_MAX
-  const uint16_t window_size { writer().available_capacity() > UINT16_MAX
-                                 ? static_cast<uint16_t>( UINT16_MAX )
-                                 : static_cast<uint16_t>( writer().available_capacity() ) };
+  uint64_t window { min<uint64_t>( writer().available_capacity(), UINT16_MAX ) };
+
+  // 接收端 SWS 避免：右边界能前进至少 min(MSS, 缓冲区的一半) 时才通告新的窗口，否则维持已通告的右边界
+  if ( sws_mss_ > 0 ) {
+    const uint64_t pushed { writer().bytes_pushed() };
+    const uint64_t threshold { min( sws_mss_, writer().capacity() / 2 ) };
+    if ( pushed + window < advertised_edge_ + threshold ) {
+      window = min( window, advertised_edge_ > pushed ? advertised_edge_ - pushed : 0 );
+    }
+  }
+  // 缓冲区正在缩小：窗口不超过目标容量剩下的部分，但也不收回已通告的右边界
+  if ( shrink_to_.has_value() ) {
+    const uint64_t pushed { writer().bytes_pushed() };
+    const uint64_t buffered { reader().bytes_buffered() };
+    const uint64_t offered { advertised_edge_ > pushed ? advertised_edge_ - pushed : 0 };
+    window = min( window, max( shrink_to_.value() > buffered ? shrink_to_.value() - buffered : 0, offered ) );
+  }
+  const uint16_t window_size { static_cast<uint16_t>( window ) };
 
   // 如果已经设置 zero_point
   if ( zero_point_.has_value() ) {
     // 计算 ACK 序列号
     const uint64_t ack_for_seqno { writer().bytes_pushed() + 1 + static_cast<uint64_t>( writer().is_closed() ) };
     // 返回一个 TCPReceiverMessage，其中包含确认序列号、窗口大小和错误状态
-    return { Wrap32::wrap( ack_for_seqno, zero_point_.value() ), window_size, writer().has_error() };
+    return { Wrap32::wrap( ack_for_seqno, zero_point_.value() ), window_size, writer().has_error(), ece_ };
+  }
+
+  return { nullopt, window_size, writer().has_error(), ece_ };
+}
+
+// 记录真正发出去的窗口：右边界只向前推进（send() 维持原边界时，这里不变）
+void TCPReceiver::advertise( const TCPReceiverMessage& message )
+{
+  advertised_edge_ = max( advertised_edge_, writer().bytes_pushed() + message.window_size );
+}
+
+// 接收缓冲区变大立即生效；变小时先缩到已通告的右边界允许的程度，余下的随着数据到达逐步缩小
+void TCPReceiver::set_capacity( uint64_t capacity )
+{
+  shrink_to_.reset();
+  if ( capacity >= writer().capacity() ) {
+    reassembler_.set_capacity( capacity );
+    return;
   }
+  shrink_to_ = capacity;
+  shrink();
+}
 
-  return { nullopt, window_size, writer().has_error() };
+// 容量至少要覆盖到已通告的右边界：bytes_pushed + capacity - bytes_buffered >= advertised_edge_
+void TCPReceiver::shrink()
+{
+  if ( not shrink_to_.has_value() ) {
+    return;
+  }
+  const uint64_t pushed { writer().bytes_pushed() };
+  const uint64_t offered { advertised_edge_ > pushed ? advertised_edge_ - pushed : 0 };
+  reassembler_.set_capacity( max( shrink_to_.value(), offered + reader().bytes_buffered() ) );
+  if ( writer().capacity() == shrink_to_.value() ) {
+    shrink_to_.reset();
+  }
 }
@@ -19,6 +19,27 @@ public:
   // The TCPReceiver sends TCPReceiverMessages to the peer's TCPSender.
   TCPReceiverMessage send() const;
 
+  // Record a message from send() that was actually transmitted: the window it advertised is what later windows
+  // are held to under SWS avoidance
+  void advertise( const TCPReceiverMessage& message );
+
+  // Receiver-side silly window syndrome avoidance (RFC 1122): only move the advertised right edge forward
+  // once it can advance by at least min(mss, capacity / 2). An mss of 0 turns it off.
+  void set_sws_avoidance( uint64_t mss ) { sws_mss_ = mss; }
+
+  // Explicit congestion notification (RFC 3168), once negotiated: after a datagram marked CE, set ECE on every
+  // message until the sender answers with CWR
+  void set_ecn( bool enabled ) { ecn_ = enabled; }
+
+  // Resize the receive buffer. It grows at once; it shrinks only as far as the right edge already advertised
+  // allows (a window once offered is not taken back), and the rest of the way as data fills that window.
+  void set_capacity( uint64_t capacity );
+
+  // Statistics (see TCPPeer::info()): segments that carried only sequence numbers received before, and segments
+  // that arrived beyond a hole
+  uint64_t duplicate_segments() const { return duplicate_segments_; }
+  uint64_t out_of_order_segments() const { return out_of_order_segments_; }
+
   // Access the output (only Reader is accessible non-const)
   const Reassembler& reassembler() const { return reassembler_; }
   Reader& reader() { return reassembler_.reader(); }
@@ -28,4 +49,18 @@ public:
 private:
   Reassembler reassembler_;
   std::optional<Wrap32> zero_point_ {}; // 存储初始序列号
+
+  uint64_t sws_mss_ {};         // 接收端 SWS 避免的 MSS，0 表示关闭
+  uint64_t advertised_edge_ {}; // 已通告窗口的右边界（流索引），只会被 advertise() 向前推进
+
+  std::optional<uint64_t> shrink_to_ {}; // 正在缩小的接收缓冲区的目标容量
+
+  // 在不收回已通告右边界的前提下，把接收缓冲区向 shrink_to_ 缩小
+  void shrink();
+
+  bool ecn_ {}; // 是否已协商使用 ECN
+  bool ece_ {}; // 收到过 CE 标记，对方还没有回应 CWR
+
+  uint64_t duplicate_segments_ {};    // 完全落在已确认部分之内的段
+  uint64_t out_of_order_segments_ {}; // 起点在下一个期待的序列号之后的段
 };
@@ -1,6 +1,10 @@
 #include "tcp_sender.hh"
+#include "ipv4_header.hh"
 #include "tcp_config.hh"
 
+#include <algorithm>
+#include <vector>
+
 using namespace std;
 
 uint64_t TCPSender::sequence_numbers_in_flight() const
@@ -16,45 +20,321 @@ uint64_t TCPSender::consecutive_retransmissions() const
   return total_retransmission_;
 }
 
+void TCPSender::configure( const TCPConfig& cfg )
+{
+  mtu_probing_ = cfg.mtu_probing;
+  trim_partial_acks_ = cfg.trim_partial_acks;
+  collapse_retransmits_ = cfg.collapse_retransmits;
+  nagle_ = cfg.nagle;
+  autocork_ = cfg.autocork;
+  cork_timeout_ms_ = cfg.cork_timeout_ms;
+  pacing_ = cfg.pacing;
+  pacing_rate_cap_ = cfg.pacing_rate_cap;
+  gso_ = cfg.gso;
+  rack_tlp_ = cfg.rack_tlp;
+  frto_ = cfg.frto;
+  congestion_control_ = cfg.congestion_control;
+  persist_ = cfg.persist_timer;
+  rtt_rto_ = cfg.adaptive_rto;
+  fastopen_ = cfg.fastopen and cfg.fastopen_cookie.has_value() and not cfg.fastopen_cookie->empty();
+  cwnd_ = congestion_control_ ? INITIAL_WINDOW_SEGMENTS * mss_ : 0;
+  if ( cfg.metrics.has_value() ) {
+    seed( cfg.metrics.value() );
+  }
+}
+
+// 类似 Linux 的 tcp_metrics：新连接从之前连接到同一目的地时测得的 RTT 和慢启动阈值起步，而不是默认的 1 秒 RTO
+void TCPSender::seed( const TCPMetrics& metrics )
+{
+  rtt_.seed( metrics.srtt_ms, metrics.rttvar_ms, metrics.min_rtt_ms );
+  rtt_rto_ = true; // 缓存的估计只是起点：之后的样本照常平滑，RTO 跟着估计走
+  timer_.reload( base_RTO_ms() );
+  if ( congestion_control_ and metrics.ssthresh > 0 ) {
+    ssthresh_ = max( metrics.ssthresh, 2 * mss_ );
+  }
+}
+
+optional<TCPMetrics> TCPSender::metrics() const
+{
+  if ( not rtt_.has_sample() ) {
+    return nullopt;
+  }
+  return TCPMetrics { .srtt_ms = rtt_.srtt_ms(),
+                      .rttvar_ms = rtt_.rttvar_ms(),
+                      .min_rtt_ms = rtt_.min_rtt_ms(),
+                      .ssthresh = ssthresh_ == UINT64_MAX ? 0 : ssthresh_ };
+}
+
+// 没有退避时的 RTO (RFC 6298)：有 RTT 估计时是 SRTT + max(G, 4 * RTTVAR)，限制在
+// [min(MIN_RTO_MS, 初始 RTO), MAX_RTO_MS] 之内；没有估计（或没有开启）时是初始 RTO
+uint64_t TCPSender::base_RTO_ms() const
+{
+  if ( not rtt_rto_ or not rtt_.has_sample() ) {
+    return initial_RTO_ms_;
+  }
+  const uint64_t rto { rtt_.srtt_ms() + max( CLOCK_GRANULARITY_MS, 4 * rtt_.rttvar_ms() ) };
+  return clamp( rto, min( MIN_RTO_MS, initial_RTO_ms_ ), MAX_RTO_MS );
+}
+
+// 实际可用的发送窗口：接收方通告的窗口和拥塞窗口中较小的一个。零窗口时，没有持续定时器就按 1 发送一个字节作为探测
+uint64_t TCPSender::send_window() const
+{
+  if ( window_size_ == 0 and persist_ ) {
+    return 0;
+  }
+  const uint64_t window { window_size_ == 0 ? 1U : window_size_ };
+  return congestion_control_ ? min( window, cwnd_ ) : window;
+}
+
+// 一个段最多携带多少负载：开启 GSO 时是若干个 MSS
+uint64_t TCPSender::max_segment_payload() const
+{
+  if ( not gso_ ) {
+    return mss_;
+  }
+
+  uint64_t segments { TCPConfig::GSO_MAX_SIZE / mss_ };
+  // pacing 时超级段不能超过桶里的令牌，否则永远等不到足够的令牌
+  if ( pacing_rate() > 0 ) {
+    segments = min( segments, pacing_tokens_ / 1000 / mss_ );
+  }
+  return max<uint64_t>( segments, 1 ) * mss_;
+}
+
+// pacing 速率：窗口 / 平滑 RTT（乘以增益），再受配置的上限约束；没有任何依据时返回 0，表示不做 pacing
+uint64_t TCPSender::pacing_rate() const
+{
+  if ( not pacing_ ) {
+    return 0;
+  }
+
+  uint64_t rate { pacing_rate_cap_ };
+  if ( rtt_.has_sample() ) {
+    const uint64_t window { max( send_window(), mss_ ) };
+    const uint64_t window_rate { window * 1000 * PACING_GAIN_PERCENT / 100 / max<uint64_t>( rtt_.srtt_ms(), 1 ) };
+    rate = rate == 0 ? window_rate : min( rate, window_rate );
+  }
+  return rate;
+}
+
+// 按经过的时间补充令牌，桶深至少能放下两个满段，也至少能放下 1ms 的发送量
+void TCPSender::refill_pacing_tokens()
+{
+  const uint64_t rate { pacing_rate() };
+  const uint64_t depth { max( 2 * mss_ * 1000, rate ) };
+  if ( rate == 0 or not pacing_refilled_ms_.has_value() ) {
+    pacing_tokens_ = depth;
+  } else {
+    pacing_tokens_ = min( depth, pacing_tokens_ + rate * ( current_time_ms_ - pacing_refilled_ms_.value() ) );
+  }
+  pacing_refilled_ms_ = rate == 0 ? nullopt : optional { current_time_ms_ };
+}
+
+// 令牌够发送 length 字节时扣除令牌并返回 true；否则记下何时令牌会够，返回 false
+bool TCPSender::pacing_allows( uint64_t length )
+{
+  const uint64_t rate { pacing_rate() };
+  const uint64_t cost { length * 1000 };
+  if ( rate == 0 ) {
+    return true;
+  }
+  if ( pacing_tokens_ >= cost ) {
+    pacing_tokens_ -= cost;
+    return true;
+  }
+  pacing_due_ms_ = current_time_ms_ + ( cost - pacing_tokens_ + rate - 1 ) / rate;
+  return false;
+}
+
+optional<uint64_t> TCPSender::ms_until_next_transmission() const
+{
+  optional<uint64_t> due;
+  const auto consider = [&]( uint64_t deadline_ms ) {
+    const uint64_t ms { deadline_ms > current_time_ms_ ? deadline_ms - current_time_ms_ : 0 };
+    due = min( due.value_or( ms ), ms );
+  };
+
+  if ( timer_.is_active() and not outstanding_.empty() ) {
+    consider( current_time_ms_ + timer_.remaining() );
+  }
+  if ( held_since_ms_.has_value() ) {
+    consider( held_since_ms_.value() + cork_timeout_ms_ );
+  }
+  if ( pacing_due_ms_.has_value() ) {
+    consider( pacing_due_ms_.value() );
+  }
+  if ( rack_due_ms_.has_value() ) {
+    consider( rack_due_ms_.value() );
+  }
+  if ( tlp_due_ms_.has_value() ) {
+    consider( tlp_due_ms_.value() );
+  }
+  if ( persist_due_ms_.has_value() ) {
+    consider( persist_due_ms_.value() );
+  }
+  return due;
+}
+
+// 一个只能装 length 字节的小段（受限于数据而不是窗口）是否应该先扣住，等更多数据一起发送
+bool TCPSender::should_hold( uint64_t length )
+{
+  if ( length >= mss_ or flush_held_ ) {
+    return false;
+  }
+
+  // 显式 cork：无论是否有数据在飞行中都扣住，但最多扣 cork_timeout_ms_
+  if ( corked_ ) {
+    if ( not held_since_ms_.has_value() ) {
+      held_since_ms_ = current_time_ms_;
+    }
+    return true;
+  }
+
+  // 自动 cork：只要还有数据在飞行中，就扣住小段，等 ACK 回来再发
+  if ( autocork_ and total_outstanding_ > 0 ) {
+    return true;
+  }
+
+  // Nagle (Minshall 变体)：之前发出的小段尚未被确认时，扣住新的小段
+  return nagle_ and small_segment_end_ > ack_abs_seqno_;
+}
+
+void TCPSender::set_mss( uint64_t mss )
+{
+  // 对方通告的 MSS 不可信：0 或极小的值会让发送方停滞（拥塞窗口为 0），或在 GSO 中除以 0
+  mss = max<uint64_t>( mss, TCPConfig::MIN_MSS );
+
+  // 开启 MTU 探测时，先用保守的段大小，再逐步向协商得到的 MSS 探测
+  if ( mtu_probing_ ) {
+    probe_floor_ = mss_ = min( mss, TCPConfig::MAX_PAYLOAD_SIZE );
+    probe_ceiling_ = mss;
+    probe_end_.reset();
+  } else {
+    mss_ = mss;
+  }
+
+  // 初始窗口按协商后的段大小计算（还没有数据被确认时）
+  if ( congestion_control_ and ack_abs_seqno_ <= 1 ) {
+    cwnd_ = INITIAL_WINDOW_SEGMENTS * mss_;
+  }
+}
+
+// 如果现在适合发送一个 MTU 探测段，返回探测段的负载大小，否则返回 0
+uint64_t TCPSender::next_probe_size( uint64_t remaining ) const
+{
+  if ( not mtu_probing_ or probe_end_.has_value() or ack_abs_seqno_ == 0 /* SYN 尚未被确认 */
+       or probe_ceiling_ < probe_floor_ + MTU_PROBE_GRANULARITY ) {
+    return 0;
+  }
+
+  // 探测段必须是满的：需要足够的数据和窗口
+  const uint64_t size { ( probe_floor_ + probe_ceiling_ + 1 ) / 2 };
+  if ( reader().bytes_buffered() < size or remaining < size ) {
+    return 0;
+  }
+  return size;
+}
+
+// 第一次发送的负载字节数（已经交给段的流字节）
+uint64_t TCPSender::bytes_sent() const
+{
+  return next_abs_seqno_ - SYN_sent_ - FIN_sent_;
+}
+
+// 发送缓冲区中还没有发送过的字节数
+uint64_t TCPSender::bytes_unsent() const
+{
+  const uint64_t next_stream_index { next_abs_seqno_ - SYN_sent_ - FIN_sent_ };
+  return reader().bytes_popped() + reader().bytes_buffered() - next_stream_index;
+}
+
+// 根据描述符从发送缓冲区中取出负载，构造一个待发送的消息
+TCPSenderMessage TCPSender::make_message( const OutstandingSegment& seg ) const
+{
+  TCPSenderMessage msg { Wrap32::wrap( seg.abs_seqno, isn_ ), seg.SYN, {}, seg.FIN, input_.has_error() };
+  if ( gso_ and not seg.probe and seg.length > mss_ ) {
+    msg.gso_size = mss_; // 超级段，由适配器切分（MTU 探测段比 MSS 大，但必须整个发出去才能探测路径）
+  }
+  // 新数据标记为 ECN-capable；SYN、重传和零窗口探测不标记 (RFC 3168 6.1.1, 6.1.5, 6.1.6)
+  if ( ecn_ and seg.length > 0 and not seg.SYN and not seg.retransmitted and window_size_ != 0 ) {
+    msg.ecn = IPv4Header::ECN_ECT0;
+  }
+
+  reader().peek( seg.abs_seqno + seg.SYN - 1 /* SYN */ - reader().bytes_popped(), seg.length, msg.payload );
+  return msg;
+}
+
 void TCPSender::push( const TransmitFunction& transmit )
 {
   // Your code here.
-  while ( ( window_size_ == 0 ? 1 : window_size_ ) > total_outstanding_ ) {
-    if ( FIN_sent_ ) {
-      break; //  如果 FIN 已发送则直接结束。
+  // RACK 或 F-RTO 判定最早的段丢失，或者对方丢弃了它（零窗口期间发出的段、不被接受的 SYN 数据）：
+  // 先快速重传它（只重传一个 MSS），不做退避
+  if ( head_lost_ or resend_front_ ) {
+    const bool congestion { head_lost_ }; // 只有丢包才说明拥塞
+    head_lost_ = resend_front_ = false;
+    if ( not outstanding_.empty() ) {
+      // 丢失的是 MTU 探测段时不减窗（probe_lost 已经把它拆成了普通大小的段）
+      const bool probe { congestion and probe_lost( 0 ) };
+      if ( congestion and not probe ) {
+        reduce_cwnd();
+      }
+      split_front();
+      retransmit( outstanding_.front(), transmit );
+      timer_.reload( congestion ? timer_.RTO() : base_RTO_ms() ); // 窗口打开时也撤销零窗口期间的退避
     }
+  }
 
-    auto msg { make_empty_message() };
+  pacing_due_ms_.reset();
+  if ( pacing_ ) {
+    refill_pacing_tokens();
+  }
+  const uint64_t next_before_push { next_abs_seqno_ };
 
-    // 如果还没有发送 SYN 位，先发送 SYN 位
-    if ( not SYN_sent_ ) {
-      msg.SYN = true;
-      SYN_sent_ = true;
+  while ( send_window() > total_outstanding_ ) {
+    if ( FIN_sent_ ) {
+      break; //  如果 FIN 已发送则直接结束。
     }
 
-    // 计算剩余的窗口大小，避免超出窗口大小
-    const uint64_t remaining { ( window_size_ == 0 ? 1 : window_size_ ) - total_outstanding_ };
-    const size_t len { min( TCPConfig::MAX_PAYLOAD_SIZE, remaining - msg.sequence_length() ) };
-    auto&& payload { msg.payload };
+    // 如果还没有发送 SYN 位，先发送 SYN 位
+    OutstandingSegment seg { .abs_seqno = next_abs_seqno_, .SYN = not SYN_sent_ };
 
-    while ( reader().bytes_buffered() > 0U and payload.size() < len ) {
-      string_view view { reader().peek() };
-      view = view.substr( 0, len - payload.size() ); // 根据剩余空间截取数据
-      payload += view;
-      input_.reader().pop( view.size() ); // 从输入流中移除已读取的数据
-    }
+    // 计算剩余的窗口大小，避免超出窗口大小（TFO：持有 cookie 时 SYN 可以带上最多一个 MSS 的数据）
+    const uint64_t remaining { seg.SYN and fastopen_ ? 1 + mss_ : send_window() - total_outstanding_ };
+    const uint64_t probe { seg.SYN ? 0 : next_probe_size( remaining ) };
+    const uint64_t unsent { bytes_unsent() };
+    seg.length = min( { probe == 0 ? max_segment_payload() : probe, remaining - seg.SYN, unsent } );
+    seg.probe = probe != 0;
 
     // 没有发送 FIN 且剩余窗口可以容纳数据且输入已结束，则发送 FIN 位
-    if ( not FIN_sent_ and remaining > msg.sequence_length() and reader().is_finished() ) {
-      msg.FIN = true;
-      FIN_sent_ = true;
+    seg.FIN = writer().is_closed() and seg.length == unsent and remaining > seg.SYN + seg.length;
+
+    // 应用写得很零碎时，先扣住小段（带 SYN 或 FIN 的段不扣）
+    if ( not seg.SYN and not seg.FIN and seg.length > 0 and seg.length == unsent and should_hold( seg.length ) ) {
+      break;
     }
 
     // 没有有效的负载，直接退出
-    if ( msg.sequence_length() == 0 ) {
+    if ( seg.sequence_length() == 0 ) {
+      break;
+    }
+
+    // 令牌不够：等 tick() 在令牌补足时再发
+    if ( pacing_ and not pacing_allows( seg.length ) ) {
       break;
     }
 
+    SYN_sent_ |= seg.SYN;
+    FIN_sent_ |= seg.FIN;
+    seg.sent_time_ms = current_time_ms_;
+    held_since_ms_.reset();
+    if ( seg.length > 0 and seg.length < mss_ ) {
+      small_segment_end_ = next_abs_seqno_ + seg.sequence_length();
+    }
+    TCPSenderMessage msg { make_message( seg ) };
+    if ( cwr_pending_ and seg.length > 0 ) {
+      msg.CWR = true;
+      cwr_pending_ = false;
+    }
     transmit( msg );
 
     // 启动定时器
@@ -63,10 +343,20 @@ void TCPSender::push( const TransmitFunction& transmit )
     }
 
     // 更新发送的绝对序列号和待确认字节数
-    next_abs_seqno_ += msg.sequence_length();
-    total_outstanding_ += msg.sequence_length();
-    outstanding_message_.emplace( move( msg ) );
+    next_abs_seqno_ += seg.sequence_length();
+    total_outstanding_ += seg.sequence_length();
+    if ( probe != 0 ) {
+      probe_size_ = probe;
+      probe_end_ = next_abs_seqno_;
+    }
+    outstanding_.push_back( seg );
+  }
+
+  // 发出了新数据，重新设置尾部丢失探测的时间
+  if ( next_abs_seqno_ != next_before_push ) {
+    arm_tlp();
   }
+  arm_persist();
 }
 
 TCPSenderMessage TCPSender::make_empty_message() const
@@ -76,7 +366,7 @@ TCPSenderMessage TCPSender::make_empty_message() const
   return { Wrap32::wrap( next_abs_seqno_, isn_ ), false, {}, false, input_.has_error() };
 }
 
-void TCPSender::receive( const TCPReceiverMessage& msg )
+void TCPSender::receive( const TCPReceiverMessage& msg, bool pure_ack )
 {
   // Your code here.
   // 接收来自接收方的 TCPReceiverMessage
@@ -88,6 +378,7 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     return;
   }
 
+  const uint16_t previous_window { window_size_ };
   window_size_ = msg.window_size; // 更新接收到的窗口大小
   if ( not msg.ackno.has_value() ) {
     return; // 没有需要处理的确认
@@ -98,39 +389,498 @@ void TCPSender::receive( const TCPReceiverMessage& msg )
     return; // 如果收到的 ack 大于当前的序列号，则跳过
   }
 
+  const uint64_t ack_before { ack_abs_seqno_ };
   bool has_acknowledgment = false;
-  while ( not outstanding_message_.empty() ) {
-    const auto& message { outstanding_message_.front() };
-    if ( ack_abs_seqno_ + message.sequence_length() > recv_ack_abs_seqno ) {
-      break; // 如果当前消息未被完全确认，则跳出循环
+  optional<uint64_t> rtt_sample;
+  while ( not outstanding_.empty() ) {
+    const auto& seg { outstanding_.front() };
+    if ( seg.abs_seqno + seg.sequence_length() > recv_ack_abs_seqno ) {
+      break; // 如果当前段未被完全确认，则跳出循环
     }
 
+    // Karn 算法：重传过的段无法区分 ACK 对应哪一次发送，不用来测量 RTT
+    if ( not seg.retransmitted ) {
+      rtt_sample = current_time_ms_ - seg.sent_time_ms;
+      rack_rtt_ms_ = rtt_sample.value();
+    }
+    rack_xmit_ms_ = max( rack_xmit_ms_, seg.sent_time_ms );
     has_acknowledgment = true;
-    ack_abs_seqno_ += message.sequence_length();
-    total_outstanding_ -= message.sequence_length();
-    outstanding_message_.pop(); // 从队列中移除已确认的消息
+    ack_abs_seqno_ += seg.sequence_length();
+    total_outstanding_ -= seg.sequence_length();
+    input_.reader().pop( seg.length ); // 已确认的字节不再需要重传，从发送缓冲区中释放
+    outstanding_.pop_front();          // 从队列中移除已确认的段
+  }
+
+  // 最早的段只被确认了一部分：裁掉已确认的前缀，之后只重传未确认的尾部（SYN 只被确认了 SYN 时总是裁掉）
+  if ( not outstanding_.empty() and outstanding_.front().abs_seqno < recv_ack_abs_seqno
+       and ( trim_partial_acks_ or outstanding_.front().SYN ) ) {
+    auto& seg { outstanding_.front() };
+    const uint64_t acked { recv_ack_abs_seqno - seg.abs_seqno };
+    const uint64_t payload_acked { acked - seg.SYN };
+
+    has_acknowledgment = true;
+    seg.SYN = false;
+    seg.abs_seqno += acked;
+    seg.length -= payload_acked;
+    ack_abs_seqno_ += acked;
+    total_outstanding_ -= acked;
+    input_.reader().pop( payload_acked );
+  }
+
+  // TFO：SYN-ACK 只确认了 SYN，对方没有接受 SYN 上的数据（cookie 无效或不支持 TFO），不等超时立即重传
+  if ( fastopen_ and ack_before == 0 and ack_abs_seqno_ == 1 and not outstanding_.empty() ) {
+    resend_front_ = true;
+  }
+
+  // 探测段被确认，说明路径可以承载更大的段
+  if ( probe_end_.has_value() and recv_ack_abs_seqno >= probe_end_.value() ) {
+    probe_floor_ = mss_ = probe_size_;
+    probe_end_.reset();
+  }
+
+  if ( rtt_sample.has_value() ) {
+    rtt_.sample( rtt_sample.value() );
   }
 
   if ( has_acknowledgment ) {
     total_retransmission_ = 0;
-    timer_.reload( initial_RTO_ms_ ); // 重置定时器和重传次数
-    outstanding_message_.empty() ? timer_.stop() : timer_.start();
+    timer_.reload( base_RTO_ms() ); // 重置定时器和重传次数（RTO 按新的 RTT 估计重新计算）
+    outstanding_.empty() ? timer_.stop() : timer_.start();
+  }
+
+  // SYN 不计入；SYN 被确认之前，确认号等于 ISN 的 ACK 没有确认任何东西（相减会下溢）
+  const uint64_t acked_from { max<uint64_t>( ack_before, 1 ) };
+  if ( ack_abs_seqno_ > acked_from ) {
+    grow_cwnd( ack_abs_seqno_ - acked_from );
+  }
+  if ( ecn_ and msg.ECE ) {
+    reduce_cwnd(); // 路径上的路由器标记了拥塞：和丢包一样减窗，但不用重传
+  }
+
+  // 窗口重新打开：停止窗口探测；还没被确认的段是在零窗口期间发出的，对方已经丢弃了
+  if ( persist_ and previous_window == 0 and window_size_ != 0 ) {
+    persist_due_ms_.reset();
+    persist_interval_ms_ = 0;
+    resend_front_ = not outstanding_.empty();
+  }
+
+  // 没有携带数据、没有推进确认点、也没有改变窗口的 ACK 是重复 ACK
+  const bool duplicate { not has_acknowledgment and pure_ack and recv_ack_abs_seqno == ack_abs_seqno_
+                         and msg.window_size == previous_window and not outstanding_.empty() };
+  if ( frto_stage_ != FRTOStage::idle ) {
+    frto_on_ack( has_acknowledgment, duplicate, recv_ack_abs_seqno );
+  }
+
+  if ( not rack_tlp_ ) {
+    return;
+  }
+  if ( has_acknowledgment ) {
+    dupacks_ = 0;
+    rack_due_ms_.reset();
+    tlp_in_flight_ = false;
+    arm_tlp();
+  } else if ( duplicate ) {
+    dupacks_++;
+    note_dupack_delivery();
+    rack_detect_loss();
+  }
+}
+
+// 每个重复 ACK 说明确认点之后又有一个线上段到达了对方：估计是哪个段，记下它的发送时间和 RTT
+void TCPSender::note_dupack_delivery()
+{
+  const uint64_t delivered { min( ack_abs_seqno_ + dupacks_ * mss_, next_abs_seqno_ - 1 ) };
+  for ( const auto& seg : outstanding_ ) {
+    if ( seg.abs_seqno + seg.sequence_length() > delivered ) {
+      rack_xmit_ms_ = max( rack_xmit_ms_, seg.sent_time_ms );
+      if ( not seg.retransmitted ) {
+        rack_rtt_ms_ = current_time_ms_ - seg.sent_time_ms;
+      }
+      return;
+    }
+  }
+}
+
+// RACK：最早的段比已送达的段发送得早，并且从发送起已经过了 RACK RTT 加上乱序窗口，就判定它丢失了
+void TCPSender::rack_detect_loss()
+{
+  rack_due_ms_.reset();
+  if ( outstanding_.empty() or head_lost_ ) {
+    return;
+  }
+
+  const auto& head { outstanding_.front() };
+  if ( head.sent_time_ms > rack_xmit_ms_ ) {
+    return; // 在已送达的段之后才（重新）发送，还无法判断
+  }
+
+  const uint64_t reordering_window { rtt_.min_rtt_ms() / 4 };
+  const uint64_t deadline { head.sent_time_ms + rack_rtt_ms_ + reordering_window };
+  if ( current_time_ms_ >= deadline ) {
+    head_lost_ = true;
+  } else {
+    rack_due_ms_ = deadline;
+  }
+}
+
+// 有数据在飞行中时，在 PTO 之后发送尾部丢失探测（RTO 会先到期时不设置）
+void TCPSender::arm_tlp()
+{
+  tlp_due_ms_.reset();
+  if ( not rack_tlp_ or tlp_in_flight_ or outstanding_.empty() or window_size_ == 0 or not rtt_.has_sample() ) {
+    return;
+  }
+  if ( ack_abs_seqno_ == 0 ) {
+    return; // 握手期间不探测，丢失的 SYN 由重传定时器处理
+  }
+
+  uint64_t pto { max( 2 * rtt_.srtt_ms(), TLP_MIN_PTO_MS ) };
+  if ( total_outstanding_ <= mss_ ) {
+    pto += TLP_MAX_ACK_DELAY_MS; // 只有一个段在飞行中，对方可能正在延迟 ACK
+  }
+  if ( pto < timer_.remaining() ) {
+    tlp_due_ms_ = current_time_ms_ + pto;
+  }
+}
+
+// 尾部丢失探测：发送一个新段（如果有），否则重传最后一个段，以引出对方的 ACK
+void TCPSender::send_tlp( const TransmitFunction& transmit )
+{
+  tlp_due_ms_.reset();
+  tlp_in_flight_ = true;
+
+  const uint64_t next_before_probe { next_abs_seqno_ };
+  flush_held_ = true;
+  push( transmit );
+  flush_held_ = false;
+
+  if ( next_abs_seqno_ == next_before_probe and not outstanding_.empty() ) {
+    if ( not probe_lost( outstanding_.size() - 1 ) ) {
+      split_back();
+    }
+    retransmit( outstanding_.back(), transmit );
   }
+  timer_.reset();
 }
 
 void TCPSender::tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit )
 {
   // Your code here.
   // 每经过时间（ms_since_last_tick），检查定时器是否超时并进行重传
-  if ( timer_.tick( ms_since_last_tick ).is_expired() ) {
-    if ( outstanding_message_.empty() ) {
+  current_time_ms_ += ms_since_last_tick;
+  account_limited_time( ms_since_last_tick );
+
+  // cork 扣住的数据等待太久了，发出去
+  if ( held_since_ms_.has_value() and current_time_ms_ - held_since_ms_.value() >= cork_timeout_ms_ ) {
+    flush_held_ = true;
+    push( transmit );
+    flush_held_ = false;
+    held_since_ms_.reset(); // 还没发出去的是被窗口挡住的，等 ACK 到来时再发，不必再按 cork 超时唤醒
+  }
+
+  // pacing 扣住的数据到期了
+  if ( pacing_due_ms_.has_value() and current_time_ms_ >= pacing_due_ms_.value() ) {
+    push( transmit );
+  }
+
+  // RTO 也到期时交给下面的超时重传处理
+  const bool rto_expired { timer_.tick( ms_since_last_tick ).is_expired() };
+
+  // 乱序窗口结束，重新判断最早的段是否丢失
+  if ( not rto_expired and rack_due_ms_.has_value() and current_time_ms_ >= rack_due_ms_.value() ) {
+    rack_detect_loss();
+    if ( head_lost_ ) {
+      push( transmit );
+    }
+  }
+
+  // 零窗口：该发窗口探测了
+  if ( persist_due_ms_.has_value() and current_time_ms_ >= persist_due_ms_.value() ) {
+    send_window_probe( transmit );
+  }
+
+  // PTO 到期还没有收到 ACK
+  if ( not rto_expired and tlp_due_ms_.has_value() and current_time_ms_ >= tlp_due_ms_.value() ) {
+    send_tlp( transmit );
+  }
+
+  if ( rto_expired ) {
+    if ( outstanding_.empty() ) {
       return;
     }
-    transmit( outstanding_message_.front() ); // 重传队列中的第一个message
+    rack_due_ms_.reset();
+    tlp_due_ms_.reset();
+
+    // 探测段丢失不代表拥塞：把它拆成普通大小的段重传，不做退避
+    if ( probe_lost( 0 ) ) {
+      retransmit( outstanding_.front(), transmit );
+      timer_.reset();
+      return;
+    }
+
+    if ( collapse_retransmits_ ) {
+      collapse_front();
+    }
+    split_front();
+    retransmit( outstanding_.front(), transmit ); // 重传队列中的第一个段
     if ( window_size_ != 0 ) {
+      frto_on_timeout();
+      // 超时说明网络状况已经未知：记下一半的飞行数据作为阈值（连续超时时不再降低），从一个 MSS 重新慢启动
+      if ( congestion_control_ ) {
+        if ( total_retransmission_ == 0 ) {
+          ssthresh_ = max( total_outstanding_ / 2, 2 * mss_ );
+        }
+        cwnd_ = mss_;
+        ca_acked_ = 0;
+        recover_ = next_abs_seqno_;
+        cwr_pending_ = ecn_;
+      }
       total_retransmission_ += 1;
       timer_.exponential_backoff(); // 每次重传超时后将 RTO 时间翻倍
+    } else if ( persist_ ) {
+      timer_.bounded_backoff( PERSIST_MAX_MS ); // 零窗口：这次重传只是探测，退避但不计入重传次数
     }
     timer_.reset();
   }
 }
+
+// 超时重传之后开始 F-RTO 判断（只判断一连串超时中的第一次）
+void TCPSender::frto_on_timeout()
+{
+  if ( not frto_ or total_retransmission_ != 0 ) {
+    frto_stage_ = FRTOStage::idle;
+    return;
+  }
+
+  frto_stage_ = FRTOStage::first_ack;
+  frto_recover_ = next_abs_seqno_;
+  frto_saved_RTO_ms_ = timer_.RTO();
+  frto_saved_cwnd_ = cwnd_;
+  frto_saved_ssthresh_ = ssthresh_;
+  frto_saved_recover_ = recover_;
+}
+
+void TCPSender::frto_on_ack( bool advanced, bool duplicate, uint64_t recv_ack_abs_seqno )
+{
+  if ( not advanced and not duplicate ) {
+    return; // 只是窗口更新，或者捎带在数据段上的 ACK
+  }
+
+  if ( frto_stage_ == FRTOStage::first_ack ) {
+    // 确认了重传的段但没有确认超时前发出的全部数据：先发新数据而不是继续重传，看下一个 ACK 确认的是什么
+    const bool can_send_new { bytes_unsent() > 0 and ack_abs_seqno_ + window_size_ > next_abs_seqno_ };
+    if ( advanced and recv_ack_abs_seqno < frto_recover_ and can_send_new ) {
+      frto_stage_ = FRTOStage::second_ack;
+      if ( congestion_control_ ) {
+        cwnd_ = max( cwnd_, total_outstanding_ + 2 * mss_ ); // 允许发出最多两个新段 (RFC 5682 2.1)
+      }
+    } else {
+      frto_stage_ = FRTOStage::idle; // 无法判断，按照普通的超时处理
+    }
+    return;
+  }
+
+  frto_stage_ = FRTOStage::idle;
+  if ( advanced ) {
+    frto_undo(); // 确认了没有重传过的数据：原来的段都到了
+  } else {
+    head_lost_ = true; // 超时是真的，后面的段也丢了：马上重传，不再等一个 RTO
+    if ( congestion_control_ ) {
+      cwnd_ = mss_; // 收回为了判断而放开的窗口，继续超时后的慢启动
+    }
+  }
+}
+
+// 虚假超时：恢复超时之前的 RTO、重传计数和拥塞状态
+void TCPSender::frto_undo()
+{
+  spurious_timeouts_++;
+  total_retransmission_ = 0;
+  if ( congestion_control_ ) {
+    cwnd_ = frto_saved_cwnd_;
+    ssthresh_ = frto_saved_ssthresh_;
+    recover_ = frto_saved_recover_;
+  }
+  timer_.reload( frto_saved_RTO_ms_ );
+  outstanding_.empty() ? timer_.stop() : timer_.start();
+}
+
+// 零窗口、没有数据在飞行中（没有 RTO 可以依靠）而且还有数据要发送时，启动持续定时器
+void TCPSender::arm_persist()
+{
+  if ( not persist_ or window_size_ != 0 or not outstanding_.empty() or persist_due_ms_.has_value() ) {
+    return;
+  }
+  if ( bytes_unsent() == 0 and ( FIN_sent_ or not writer().is_closed() ) ) {
+    return;
+  }
+
+  if ( persist_interval_ms_ == 0 ) {
+    persist_interval_ms_ = base_RTO_ms();
+  }
+  persist_due_ms_ = current_time_ms_ + persist_interval_ms_;
+}
+
+// 窗口探测：用一个已经确认过的序列号发送空段，对方会丢弃它，但会回复一个带当前窗口的 ACK
+void TCPSender::send_window_probe( const TransmitFunction& transmit )
+{
+  TCPSenderMessage probe { make_empty_message() };
+  probe.seqno = Wrap32::wrap( next_abs_seqno_ - 1, isn_ );
+  transmit( probe );
+  window_probes_++;
+
+  persist_interval_ms_ = min( persist_interval_ms_ * 2, PERSIST_MAX_MS );
+  persist_due_ms_ = current_time_ms_ + persist_interval_ms_;
+}
+
+// 收到新的确认时增大拥塞窗口：慢启动时按确认的字节增长（每个 ACK 最多两个 MSS，RFC 3465），
+// 拥塞避免时每个 RTT 增加一个 MSS
+void TCPSender::grow_cwnd( uint64_t acked )
+{
+  if ( not congestion_control_ or acked == 0 ) {
+    return;
+  }
+  if ( recover_.has_value() and ack_abs_seqno_ >= recover_.value() ) {
+    recover_.reset(); // 减窗时在飞行中的数据都确认了，下一次拥塞事件可以再减窗
+  }
+
+  if ( cwnd_ < ssthresh_ ) {
+    cwnd_ += min( acked, 2 * mss_ );
+    return;
+  }
+  ca_acked_ += acked;
+  if ( ca_acked_ >= cwnd_ ) {
+    ca_acked_ -= cwnd_;
+    cwnd_ += mss_;
+  }
+}
+
+// 拥塞事件（丢包或 ECN-Echo）：ssthresh 和 cwnd 减为飞行中数据的一半，每个窗口的数据最多减一次
+void TCPSender::reduce_cwnd()
+{
+  if ( not congestion_control_ or recover_.has_value() ) {
+    return;
+  }
+  recover_ = next_abs_seqno_;
+  ssthresh_ = max( total_outstanding_ / 2, 2 * mss_ );
+  cwnd_ = ssthresh_;
+  ca_acked_ = 0;
+  cwr_pending_ = ecn_; // 告诉接收方已经减了窗口，它可以停止回显 ECE
+}
+
+// MTU 探测段丢失（由 RTO、RACK 或 TLP 发现）不代表拥塞 (RFC 4821)：降低探测上限，避免再探测同样的大小，
+// 并把它拆成普通大小的段。下标处的段是探测段时返回 true，调用者不应再减窗
+bool TCPSender::probe_lost( size_t index )
+{
+  const OutstandingSegment probe { outstanding_[index] };
+  if ( not probe_end_.has_value() or probe.abs_seqno + probe.sequence_length() != probe_end_ ) {
+    return false;
+  }
+  probe_ceiling_ = probe_size_ - 1;
+  probe_end_.reset();
+
+  vector<OutstandingSegment> pieces;
+  for ( uint64_t offset = 0; offset < probe.length; offset += mss_ ) {
+    pieces.push_back( { .abs_seqno = probe.abs_seqno + offset,
+                        .length = min( mss_, probe.length - offset ),
+                        .sent_time_ms = probe.sent_time_ms } );
+  }
+  pieces.back().FIN = probe.FIN;
+  const auto at { outstanding_.erase( outstanding_.begin() + static_cast<ptrdiff_t>( index ) ) };
+  outstanding_.insert( at, pieces.begin(), pieces.end() );
+  return true;
+}
+
+// 把紧跟在最早的段后面的小段合并进来，使一次重传最多携带一个 MSS 的数据
+void TCPSender::collapse_front()
+{
+  OutstandingSegment merged { outstanding_.front() };
+  if ( merged.SYN ) {
+    return; // 不把数据并入 SYN：对方未必接受 SYN 上的数据
+  }
+
+  // 先按下标合并到局部的描述符里，最后一次性删除被并入的描述符（从 deque 中间删除会使引用失效）
+  size_t end { 1 };
+  while ( end < outstanding_.size() and not merged.FIN ) {
+    const auto& next { outstanding_[end] };
+    if ( merged.length + next.length > mss_ ) {
+      break;
+    }
+
+    // 探测段被合并后，无法再判断探测是否成功，放弃这次探测
+    if ( probe_end_.has_value() and next.abs_seqno + next.sequence_length() == probe_end_ ) {
+      probe_end_.reset();
+    }
+
+    merged.length += next.length;
+    merged.FIN = next.FIN;
+    end++;
+  }
+
+  outstanding_.erase( outstanding_.begin() + 1, outstanding_.begin() + static_cast<ptrdiff_t>( end ) );
+  outstanding_.front() = merged;
+}
+
+// 超级段超时后只重传第一个 MSS，其余部分作为另一个描述符留在队列中
+void TCPSender::split_front()
+{
+  auto& front { outstanding_.front() };
+  if ( front.length <= mss_ ) {
+    return;
+  }
+  if ( probe_end_ == front.abs_seqno + front.sequence_length() ) {
+    probe_end_.reset(); // 探测段被拆开了，无法再判断探测是否成功
+  }
+
+  OutstandingSegment rest { front };
+  rest.SYN = false;
+  rest.abs_seqno = front.abs_seqno + front.SYN + mss_;
+  rest.length = front.length - mss_;
+  front.length = mss_;
+  front.FIN = false;
+  outstanding_.insert( outstanding_.begin() + 1, rest );
+}
+
+// 把最后一个段的最后一个 MSS 拆成单独的描述符，尾部探测只重传这一部分
+void TCPSender::split_back()
+{
+  auto& back { outstanding_.back() };
+  if ( back.length <= mss_ ) {
+    return;
+  }
+  if ( probe_end_ == back.abs_seqno + back.sequence_length() ) {
+    probe_end_.reset();
+  }
+
+  OutstandingSegment tail { back };
+  tail.SYN = false;
+  tail.abs_seqno = back.abs_seqno + back.SYN + back.length - mss_;
+  tail.length = mss_;
+  back.length -= mss_;
+  back.FIN = false;
+  outstanding_.push_back( tail );
+}
+
+// 重传一个未确认段
+void TCPSender::retransmit( OutstandingSegment& seg, const TransmitFunction& transmit )
+{
+  seg.sent_time_ms = current_time_ms_;
+  seg.retransmitted = true;
+  bytes_retransmitted_ += seg.length;
+  retransmissions_++;
+  transmit( make_message( seg ) );
+}
+
+// 把过去的 ms 毫秒记到限制发送的一方：还有数据（或 FIN）要发而窗口满了，是窗口；
+// 没有数据要发，是应用；窗口没满却没发（Nagle、cork、pacing）不记
+void TCPSender::account_limited_time( uint64_t ms )
+{
+  if ( not SYN_acked() or FIN_sent_ ) {
+    return;
+  }
+  if ( bytes_unsent() == 0 and not writer().is_closed() ) {
+    app_limited_ms_ += ms;
+  } else if ( total_outstanding_ >= send_window() ) {
+    ( congestion_control_ and cwnd_ < window_size_ ? cwnd_limited_ms_ : rwnd_limited_ms_ ) += ms;
+  }
+}
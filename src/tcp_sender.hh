@@ -1,10 +1,12 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "tcp_config.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_sender_message.hh"
 
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
@@ -20,6 +22,11 @@ public:
   [[nodiscard]] constexpr auto is_expired() const noexcept -> bool { return is_active_ and timer_ >= RTO_ms_; }
   constexpr auto reset() noexcept -> void { timer_ = 0; }
   constexpr auto exponential_backoff() noexcept -> void { RTO_ms_ *= 2; } // 每次重传超时后将 RTO 时间翻倍
+  constexpr auto bounded_backoff( uint64_t max_RTO_ms ) noexcept -> void
+  {
+    RTO_ms_ = RTO_ms_ * 2 > max_RTO_ms ? max_RTO_ms : RTO_ms_ * 2;
+  } // 翻倍，但不超过 max_RTO_ms
+  [[nodiscard]] constexpr auto RTO() const noexcept -> uint64_t { return RTO_ms_; }
   constexpr auto reload( uint64_t initial_RTO_ms ) noexcept -> void
   {
     RTO_ms_ = initial_RTO_ms, reset();
@@ -31,6 +38,11 @@ public:
     timer_ += is_active_ ? ms_since_last_tick : 0;
     return *this;
   }
+  // 距离超时还剩多少毫秒
+  [[nodiscard]] constexpr auto remaining() const noexcept -> uint64_t
+  {
+    return timer_ >= RTO_ms_ ? 0 : RTO_ms_ - timer_;
+  }
 
 private:
   bool is_active_ {};
@@ -38,6 +50,45 @@ private:
   uint64_t timer_ {};
 };
 
+// 往返时间估计 (RFC 6298)：平滑 RTT、RTT 偏差和观测到的最小 RTT
+class RTTEstimator
+{
+public:
+  constexpr auto sample( uint64_t rtt_ms ) noexcept -> void
+  {
+    if ( not has_sample_ ) {
+      has_sample_ = true;
+      srtt_ms_ = min_rtt_ms_ = rtt_ms;
+      rttvar_ms_ = rtt_ms / 2;
+      return;
+    }
+    const uint64_t deviation { srtt_ms_ > rtt_ms ? srtt_ms_ - rtt_ms : rtt_ms - srtt_ms_ };
+    rttvar_ms_ = ( 3 * rttvar_ms_ + deviation ) / 4;
+    srtt_ms_ = ( 7 * srtt_ms_ + rtt_ms ) / 8;
+    min_rtt_ms_ = rtt_ms < min_rtt_ms_ ? rtt_ms : min_rtt_ms_;
+  }
+
+  // 用之前的连接测得的值作为初始估计，之后的样本在此基础上平滑
+  constexpr auto seed( uint64_t srtt_ms, uint64_t rttvar_ms, uint64_t min_rtt_ms ) noexcept -> void
+  {
+    has_sample_ = true;
+    srtt_ms_ = srtt_ms;
+    rttvar_ms_ = rttvar_ms;
+    min_rtt_ms_ = min_rtt_ms;
+  }
+
+  [[nodiscard]] constexpr auto has_sample() const noexcept -> bool { return has_sample_; }
+  [[nodiscard]] constexpr auto srtt_ms() const noexcept -> uint64_t { return srtt_ms_; }
+  [[nodiscard]] constexpr auto rttvar_ms() const noexcept -> uint64_t { return rttvar_ms_; }
+  [[nodiscard]] constexpr auto min_rtt_ms() const noexcept -> uint64_t { return min_rtt_ms_; }
+
+private:
+  bool has_sample_ {};
+  uint64_t srtt_ms_ {};
+  uint64_t rttvar_ms_ {};
+  uint64_t min_rtt_ms_ {};
+};
+
 class TCPSender
 {
 public:
@@ -46,11 +97,32 @@ public:
     : input_( std::move( input ) ), isn_( isn ), initial_RTO_ms_( initial_RTO_ms ), timer_( initial_RTO_ms )
   {}
 
+  /* Apply the per-connection policies in a TCPConfig (a freshly constructed sender has them all disabled) */
+  void configure( const TCPConfig& cfg );
+
+  /* Start from what an earlier connection to the same destination measured: the RTT estimate (and an RTO
+   * derived from it) and the slow-start threshold */
+  void seed( const TCPMetrics& metrics );
+
+  /* What this connection has measured about the path, to seed later ones (nothing before the first RTT sample) */
+  std::optional<TCPMetrics> metrics() const;
+
+  /* Set the maximum payload size of outgoing segments, as negotiated with the peer */
+  void set_mss( uint64_t mss );
+
+  /* Use explicit congestion notification (negotiated with the peer): mark new data ECN-capable, treat ECE
+   * like a loss, and answer it with CWR */
+  void set_ecn( bool enabled ) { ecn_ = enabled; }
+
+  /* Cork the sender: while corked, only full-sized segments are sent (TCP_CORK) */
+  void set_cork( bool corked ) { corked_ = corked; }
+
   /* Generate an empty TCPSenderMessage */
   TCPSenderMessage make_empty_message() const;
 
-  /* Receive and process a TCPReceiverMessage from the peer's receiver */
-  void receive( const TCPReceiverMessage& msg );
+  /* Receive and process a TCPReceiverMessage from the peer's receiver
+   * (pure_ack: the segment carrying it had no data of its own, so a repeated ackno is a duplicate ACK) */
+  void receive( const TCPReceiverMessage& msg, bool pure_ack = true );
 
   /* Type of the `transmit` function that the push and tick methods can use to send messages */
   using TransmitFunction = std::function<void( const TCPSenderMessage& )>;
@@ -61,14 +133,40 @@ public:
   /* Time has passed by the given # of milliseconds since the last time the tick() method was called */
   void tick( uint64_t ms_since_last_tick, const TransmitFunction& transmit );
 
+  /* How long until tick() next has something to send (paced, corked or retransmitted data), if anything */
+  std::optional<uint64_t> ms_until_next_transmission() const;
+
   // Accessors
   uint64_t sequence_numbers_in_flight() const;  // How many sequence numbers are outstanding?
   uint64_t consecutive_retransmissions() const; // How many consecutive *re*transmissions have happened?
+  uint64_t mss() const { return mss_; }         // Current maximum payload size of outgoing segments
+  // Payload size of the MTU probe in flight, which may exceed mss() (0 = no probe in flight)
+  uint64_t mtu_probe_size() const { return probe_end_.has_value() ? probe_size_ : 0; }
   Writer& writer() { return input_.writer(); }
   const Writer& writer() const { return input_.writer(); }
 
-  // Access input stream reader, but const-only (can't read from outside)
+  // Access input stream reader, but const-only (can't read from outside).
+  // Bytes stay buffered in the input stream until they are acknowledged.
   const Reader& reader() const { return input_.reader(); }
+  bool FIN_sent() const { return FIN_sent_; } // Has the whole outbound stream been handed to segments?
+  bool SYN_acked() const { return ack_abs_seqno_ > 0; } // Has the peer acknowledged our SYN?
+  const RTTEstimator& rtt() const { return rtt_; } // Round-trip time measured from acknowledgments
+  uint64_t pacing_rate() const;                    // Current pacing rate in bytes per second (0 = unpaced)
+  uint64_t spurious_timeouts() const { return spurious_timeouts_; } // Timeouts F-RTO found to be spurious
+  uint64_t cwnd() const { return cwnd_; }         // Congestion window, in sequence numbers (0 = not limited)
+  uint64_t ssthresh() const { return ssthresh_; } // Slow-start threshold
+  uint64_t window_probes() const { return window_probes_; } // Zero-window probes sent by the persist timer
+  uint64_t peer_window() const { return window_size_; }     // Window the peer last advertised
+  uint64_t RTO_ms() const { return timer_.RTO(); }          // Current retransmission timeout
+  bool SYN_sent() const { return SYN_sent_; }               // Has our SYN been sent?
+
+  // Statistics (see TCPPeer::info())
+  uint64_t bytes_sent() const;                                          // Payload bytes sent for the first time
+  uint64_t bytes_retransmitted() const { return bytes_retransmitted_; } // Payload bytes sent again
+  uint64_t retransmissions() const { return retransmissions_; }         // Segments sent again
+  uint64_t rwnd_limited_ms() const { return rwnd_limited_ms_; } // Time the flight filled the peer's window
+  uint64_t cwnd_limited_ms() const { return cwnd_limited_ms_; } // Time the flight filled the congestion window
+  uint64_t app_limited_ms() const { return app_limited_ms_; }   // Time with room to send but nothing written
 
 private:
   // Variables initialized in constructor
@@ -76,6 +174,12 @@ private:
   Wrap32 isn_; // 初始序列号
   uint64_t initial_RTO_ms_;
 
+  static constexpr uint64_t MIN_RTO_MS = 200;         // 由 RTT 算出的 RTO 的下限（配置的 rt_timeout 更小时以它为准）
+  static constexpr uint64_t MAX_RTO_MS = 60000;       // 由 RTT 算出的 RTO 的上限
+  static constexpr uint64_t CLOCK_GRANULARITY_MS = 1; // 时钟粒度 G
+  bool rtt_rto_ {};                                   // 由 RTT 估计计算 RTO，而不是一直用初始 RTO
+  uint64_t base_RTO_ms() const;
+
   RetransmissionTimer timer_;
 
   bool SYN_sent_ {};
@@ -84,8 +188,144 @@ private:
   uint64_t next_abs_seqno_ {};
   uint64_t ack_abs_seqno_ {};
   uint16_t window_size_ { 1 };
-  std::queue<TCPSenderMessage> outstanding_message_ {}; // 用于存储未确认的 TCP 消息。
+  // 未确认段的描述符。负载本身留在 input_ 中（按序列号索引），直到被确认才弹出，
+  // 所以发送和重传时都直接从发送缓冲区构造负载，不再额外保存一份消息副本。
+  struct OutstandingSegment
+  {
+    uint64_t abs_seqno {};    // 段的起始绝对序列号
+    uint64_t length {};       // 负载长度
+    bool SYN {};
+    bool FIN {};
+    uint64_t sent_time_ms {}; // 最近一次发送的时间
+    bool retransmitted {};    // 是否被重传过
+    bool probe {};            // MTU 探测段：要作为一个完整的段发出，不能当作超级段被切开
+
+    uint64_t sequence_length() const { return SYN + length + FIN; }
+  };
+  std::deque<OutstandingSegment> outstanding_ {};
+  uint64_t current_time_ms_ {}; // 由 tick() 累积的时间
+
+  uint64_t bytes_unsent() const;
+  TCPSenderMessage make_message( const OutstandingSegment& seg ) const;
+  void retransmit( OutstandingSegment& seg, const TransmitFunction& transmit );
 
   uint64_t total_outstanding_ {};
   uint64_t total_retransmission_ {};
+
+  uint64_t mss_ { TCPConfig::MAX_PAYLOAD_SIZE }; // 当前每个段的最大负载
+
+  // 分段卸载 (GSO)：一次构造多个 MSS 的超级段，由适配器在最后切成线上大小的段
+  bool gso_ {};
+  uint64_t max_segment_payload() const;
+  void split_front();
+  void split_back();
+
+  bool trim_partial_acks_ {};    // 部分确认时裁掉已确认的前缀
+  bool collapse_retransmits_ {}; // 超时重传时把连续的小段合并成一个 MSS 大小的段
+  void collapse_front();
+
+  // 小段合并：Nagle (Minshall 变体)、自动 cork、显式 cork
+  bool nagle_ {};
+  bool autocork_ {};
+  bool corked_ {};
+  uint64_t cork_timeout_ms_ {};
+  uint64_t small_segment_end_ {};            // 最近发送的小段的结束绝对序列号
+  std::optional<uint64_t> held_since_ms_ {}; // 因 cork 被扣住的数据从何时开始等待
+  bool flush_held_ {};                       // 忽略上述规则，把扣住的数据立即发出
+  bool should_hold( uint64_t length );
+
+  // 分组层路径 MTU 探测 (RFC 4821)：在 [probe_floor_, probe_ceiling_] 之间二分查找可用的段大小
+  static constexpr uint64_t MTU_PROBE_GRANULARITY = 32; // 区间小于该值时停止探测
+  bool mtu_probing_ {};
+  uint64_t probe_floor_ {};                  // 已确认可以通过的段大小
+  uint64_t probe_ceiling_ {};                // 协商得到的 MSS，探测的上限
+  uint64_t probe_size_ {};                   // 正在飞行中的探测段的负载大小
+  std::optional<uint64_t> probe_end_ {};     // 正在飞行中的探测段的结束绝对序列号
+  uint64_t next_probe_size( uint64_t remaining ) const;
+  bool probe_lost( size_t index );
+
+  RTTEstimator rtt_ {};
+
+  // 发送端 pacing：令牌桶按 pacing_rate() 积累令牌，令牌不够时扣住新数据，由 tick() 在到期时放行。
+  // 令牌以"毫字节"为单位（速率 B/s 乘以毫秒），避免低速率时每毫秒的积累被舍入为 0
+  static constexpr uint64_t PACING_GAIN_PERCENT = 125; // 按窗口/RTT 计算的速率再留一些余量，避免 pacing 限制吞吐
+  bool pacing_ {};
+  uint64_t pacing_rate_cap_ {}; // 配置的速率上限 (B/s)，0 表示不设上限
+  uint64_t pacing_tokens_ {};
+  std::optional<uint64_t> pacing_refilled_ms_ {}; // 上次补充令牌的时间，尚未开始 pacing 时为空（桶是满的）
+  std::optional<uint64_t> pacing_due_ms_ {};      // 被 pacing 扣住的数据何时可以发送
+  void refill_pacing_tokens();
+  bool pacing_allows( uint64_t length );
+
+  // RACK-TLP (RFC 8985)。没有 SACK，所以把每个重复 ACK 当作确认点之后又有一个线上段送达的证据
+  static constexpr uint64_t TLP_MAX_ACK_DELAY_MS = 200; // 只有一个段在飞行中时，对方可能延迟 ACK 的最长时间
+  static constexpr uint64_t TLP_MIN_PTO_MS = 10;
+  bool rack_tlp_ {};
+  uint64_t dupacks_ {};                    // 连续的重复 ACK 个数
+  uint64_t rack_xmit_ms_ {};               // 已送达的段中最近一次发送的时间
+  uint64_t rack_rtt_ms_ {};                // 该段的 RTT
+  std::optional<uint64_t> rack_due_ms_ {}; // 乱序窗口何时结束，届时重新判断最早的段是否丢失
+  bool head_lost_ {};                      // 最早的段已被判定丢失（RACK 或 F-RTO），由 push() 快速重传
+  std::optional<uint64_t> tlp_due_ms_ {};  // 何时发送尾部丢失探测
+  bool tlp_in_flight_ {};                  // 探测已发出，在收到新的确认之前不再探测
+  void note_dupack_delivery();
+  void rack_detect_loss();
+  void arm_tlp();
+  void send_tlp( const TransmitFunction& transmit );
+
+  // F-RTO (RFC 5682)：超时重传之后看接下来的两个 ACK。如果第二个 ACK 确认了没有重传过的数据，
+  // 说明原来的段只是被延迟了，这次超时是虚假的，撤销超时带来的退避
+  enum class FRTOStage
+  {
+    idle,       // 没有在判断
+    first_ack,  // 已超时重传，等待第一个 ACK
+    second_ack, // 第一个 ACK 确认了重传的段并发出了新数据，等待第二个 ACK
+  };
+  bool frto_ {};
+  FRTOStage frto_stage_ { FRTOStage::idle };
+  uint64_t frto_recover_ {};      // 超时时已发送的最高绝对序列号
+  uint64_t frto_saved_RTO_ms_ {}; // 超时退避之前的 RTO
+  uint64_t frto_saved_cwnd_ {};   // 超时之前的拥塞状态
+  uint64_t frto_saved_ssthresh_ {};
+  std::optional<uint64_t> frto_saved_recover_ {};
+  uint64_t spurious_timeouts_ {};
+  void frto_on_timeout();
+  void frto_on_ack( bool advanced, bool duplicate, uint64_t recv_ack_abs_seqno );
+  void frto_undo();
+
+  // 拥塞控制 (RFC 5681)：慢启动、拥塞避免；丢包或收到 ECN-Echo 时减半，超时后从一个 MSS 重新慢启动
+  static constexpr uint64_t INITIAL_WINDOW_SEGMENTS = 10; // 初始窗口 (RFC 6928)
+  bool congestion_control_ {};
+  uint64_t cwnd_ {};                   // 拥塞窗口（序列号个数）
+  uint64_t ssthresh_ { UINT64_MAX };   // 慢启动阈值
+  uint64_t ca_acked_ {};               // 拥塞避免时累计确认的字节，每攒够一个 cwnd 增加一个 MSS
+  std::optional<uint64_t> recover_ {}; // 减窗时已发送的最高序列号，确认越过它之前不再减窗
+  bool ecn_ {};
+  bool cwr_pending_ {}; // 减窗后，在下一个新数据段上带 CWR
+  uint64_t send_window() const;
+  void grow_cwnd( uint64_t acked );
+  void reduce_cwnd();
+
+  // 持续定时器 (RFC 9293 3.8.6.1)：对方通告零窗口时不再把一个字节的数据当作探测反复重传，而是按有上限的
+  // 指数退避发送窗口探测（一个已确认过的序列号，对方会回复带当前窗口的 ACK），直到窗口重新打开
+  static constexpr uint64_t PERSIST_MAX_MS = 60000; // 探测间隔的上限
+  bool persist_ {};
+  std::optional<uint64_t> persist_due_ms_ {}; // 下一次发送窗口探测的时间
+  uint64_t persist_interval_ms_ {};           // 当前的探测间隔，每次探测后翻倍
+  uint64_t window_probes_ {};
+  void arm_persist();
+  void send_window_probe( const TransmitFunction& transmit );
+
+  // TCP Fast Open (RFC 7413)：持有对方发的 cookie 时，SYN 上就带着数据发出去，省掉一个 RTT
+  bool fastopen_ {};
+  bool resend_front_ {}; // 对方丢弃了最早的在途段（零窗口期间发出的，或者没被接受的 SYN 数据），由 push() 立即重传
+
+  // 统计：重传的字节数和段数，以及握手之后、整个流发完之前，每段时间是什么限制了发送（由 tick() 按上一次 push()
+  // 之后的状态累计）。都是简单的计数，一直开着
+  uint64_t bytes_retransmitted_ {};
+  uint64_t retransmissions_ {};
+  uint64_t rwnd_limited_ms_ {}; // 飞行中的数据占满了对方通告的窗口
+  uint64_t cwnd_limited_ms_ {}; // 飞行中的数据占满了（更小的）拥塞窗口
+  uint64_t app_limited_ms_ {};  // 窗口还有空余，但应用没有写入更多数据
+  void account_limited_time( uint64_t ms );
 };
@@ -0,0 +1,154 @@
+#include "tcp_sharded_stack.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+static constexpr uint16_t EPHEMERAL_PORT_FIRST = 49152;
+static constexpr size_t EPHEMERAL_PORTS = 65536 - EPHEMERAL_PORT_FIRST;
+
+TCPShardedStack::Shard::Shard( size_t index, size_t shards, const TCPConfig& cfg )
+  : index_( index )
+  , shards_( shards )
+  , manager_( cfg )
+  , next_port_( EPHEMERAL_PORT_FIRST + index * EPHEMERAL_PORTS / shards )
+{
+  // the wakeup only has to get the shard out of poll(); the shard drains its inbox itself
+  eventloop_.add_rule( "wakeup", wakeup_, EventLoop::Direction::In, [this] { wakeup_.clear(); } );
+}
+
+FourTuple TCPShardedStack::Shard::connect( const string& local_ip, const Address& remote )
+{
+  const uint32_t local = Address { local_ip, 0 }.ipv4_numeric();
+  for ( size_t tries = 0; tries < EPHEMERAL_PORTS; ++tries ) {
+    const FourTuple id { local, next_port_, remote.ipv4_numeric(), remote.port() };
+    next_port_ = next_port_ == UINT16_MAX ? EPHEMERAL_PORT_FIRST : next_port_ + 1;
+    if ( FourTupleHash {}( id ) % shards_ == index_ and manager_.find( id ) == nullptr ) {
+      return manager_.connect( Address { local_ip, id.local_port }, remote );
+    }
+  }
+  throw runtime_error( "no ephemeral port left on shard " + to_string( index_ ) + " for " + remote.to_string() );
+}
+
+TCPShardedStack::TCPShardedStack( size_t shards, const TCPConfig& cfg, Output output, ShardTask task )
+  : output_( std::move( output ) ), task_( std::move( task ) )
+{
+  if ( shards == 0 ) {
+    throw runtime_error( "TCPShardedStack needs at least one shard" );
+  }
+  for ( size_t i = 0; i < shards; ++i ) {
+    shards_.push_back( make_unique<Shard>( i, shards, cfg ) );
+  }
+}
+
+void TCPShardedStack::listen( uint16_t port, size_t syn_backlog, size_t accept_backlog )
+{
+  for ( const auto& shard : shards_ ) {
+    shard->manager_.listen( port, syn_backlog, accept_backlog );
+  }
+}
+
+void TCPShardedStack::start()
+{
+  for ( const auto& shard : shards_ ) {
+    shard->thread_ = thread( &TCPShardedStack::run, this, ref( *shard ) );
+  }
+}
+
+size_t TCPShardedStack::shard_for( const InternetDatagram& dgram ) const
+{
+  // the ports are the first four bytes of the TCP header, which may be split across payload buffers
+  array<uint8_t, 4> ports {};
+  size_t have = 0;
+  for ( const auto& buffer : dgram.payload ) {
+    for ( size_t i = 0; i < buffer.size() and have < ports.size(); ++i ) {
+      ports.at( have++ ) = static_cast<uint8_t>( buffer[i] );
+    }
+  }
+  if ( dgram.header.proto != IPv4Header::PROTO_TCP or have < ports.size() ) {
+    return 0;
+  }
+
+  // the datagram's destination is the local end
+  const FourTuple id { .local_ip = dgram.header.dst,
+                       .local_port = static_cast<uint16_t>( ports[2] << 8 | ports[3] ),
+                       .remote_ip = dgram.header.src,
+                       .remote_port = static_cast<uint16_t>( ports[0] << 8 | ports[1] ) };
+  return shard_for( id );
+}
+
+void TCPShardedStack::deliver( InternetDatagram&& dgram )
+{
+  Shard& shard = *shards_[shard_for( dgram )];
+  if ( not shard.inbox_.push( std::move( dgram ) ) ) {
+    return;
+  }
+
+  // pairs with the fence in run(): either the shard sees the datagram before it sleeps, or we see it asleep
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( shard.sleeping_.exchange( false ) ) {
+    shard.wakeup_.notify();
+  }
+}
+
+void TCPShardedStack::run( Shard& shard )
+{
+  try {
+    auto base_time = timestamp_ms();
+    while ( not stop_ ) {
+      bool busy = false;
+      while ( auto dgram = shard.inbox_.pop() ) {
+        shard.manager_.receive( *dgram );
+        busy = true;
+      }
+
+      const auto next_time = timestamp_ms();
+      shard.manager_.tick( next_time - base_time );
+      base_time = next_time;
+
+      task_( shard );
+
+      auto& datagrams_out = shard.manager_.datagrams_out();
+      while ( not datagrams_out.empty() ) {
+        InternetDatagram dgram = std::move( datagrams_out.front() );
+        datagrams_out.pop();
+        output_( shard, std::move( dgram ) );
+        busy = true;
+      }
+
+      // sleep only when a round found nothing to do, until a datagram arrives or a connection's next deadline
+      if ( not busy ) {
+        shard.sleeping_ = true;
+        atomic_thread_fence( memory_order_seq_cst );
+        if ( shard.inbox_.empty() and not stop_ ) {
+          shard.eventloop_.wait_next_event( poll_timeout_ms( shard.manager_.ms_until_next_tick() ) );
+        }
+        shard.sleeping_ = false;
+      } else {
+        shard.eventloop_.wait_next_event( 0 );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << "Exception in TCPShardedStack shard " << shard.index_ << ": " << e.what() << "\n";
+    throw e;
+  }
+}
+
+TCPShardedStack::~TCPShardedStack()
+{
+  stop_ = true;
+  for ( const auto& shard : shards_ ) {
+    shard->wakeup_.notify();
+  }
+  for ( const auto& shard : shards_ ) {
+    if ( shard->thread_.joinable() ) {
+      shard->thread_.join();
+    }
+  }
+}
@@ -97,6 +97,37 @@ int main()
       test.execute( BytesBuffered { 1 } );
     }
 
+    {
+      ByteStreamTestHarness test { "set_capacity", 2 };
+
+      test.execute( Push { "cat" } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( SetCapacity { 5 } );
+      test.execute( AvailableCapacity { 3 } );
+      test.execute( Push { "cat" } );
+      test.execute( BytesBuffered { 5 } );
+      test.execute( Peek { "cacat" } );
+      test.execute( SetCapacity { 1 } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( BytesBuffered { 5 } );
+      test.execute( Pop { 5 } );
+      test.execute( SetCapacity { 1 } );
+      test.execute( AvailableCapacity { 1 } );
+    }
+
+    {
+      ByteStreamTestHarness test { "bytes peeked but not popped still take capacity", 4 };
+
+      test.execute( Push { "abcd" } );
+      test.execute( PeekAt { 1, 2, "bc" } );
+      test.execute( AvailableCapacity { 0 } );
+      test.execute( Push { "e" } );
+      test.execute( BytesPushed { 4 } );
+      test.execute( Pop { 2 } );
+      test.execute( AvailableCapacity { 2 } );
+      test.execute( PeekAt { 0, 4, "cd" } );
+    }
+
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << endl;
     return EXIT_FAILURE;
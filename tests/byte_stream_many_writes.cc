@@ -39,6 +39,54 @@ int main()
       }
     }
 
+    {
+      ByteStreamTestHarness test { "peek at an offset across many writes", CAPACITY };
+
+      for ( const char c : string { "abcdefghij" } ) {
+        test.execute( Push { string( 1, c ) } );
+      }
+      test.execute( Push { "klm" } );
+      test.execute( Push { "nopqrstuvwxyz" } );
+
+      test.execute( PeekAt { 0, 3, "abc" } );
+      test.execute( PeekAt { 8, 5, "ijklm" } );
+      test.execute( PeekAt { 12, 3, "mno" } );
+      test.execute( PeekAt { 20, 10, "uvwxyz" } );
+      test.execute( PeekAt { 26, 1, "" } );
+      test.execute( BytesBuffered { 26 } );
+
+      test.execute( Pop { 4 } );
+      test.execute( PeekAt { 0, 2, "ef" } );
+      test.execute( PeekAt { 15, 3, "tuv" } );
+      test.execute( Pop { 8 } );
+      test.execute( PeekAt { 0, 14, "mnopqrstuvwxyz" } );
+      test.execute( Peek { "mnopqrstuvwxyz" } );
+    }
+
+    {
+      ByteStreamTestHarness test { "peek at random offsets", CAPACITY };
+
+      string all;
+      for ( size_t i = 0; i < NREPS; ++i ) {
+        string d( 1 + ( rd() % MIN_WRITE ), 0 );
+        generate( d.begin(), d.end(), [&] { return 'a' + ( rd() % 26 ); } );
+        test.execute( Push { d } );
+        all += d;
+      }
+
+      size_t popped = 0;
+      for ( size_t i = 0; i < NREPS; ++i ) {
+        const size_t offset = rd() % ( all.size() - popped );
+        const size_t len = rd() % MAX_WRITE;
+        test.execute( PeekAt { offset, len, all.substr( popped + offset, len ) } );
+        if ( i % 10 == 0 ) {
+          const size_t n = rd() % MIN_WRITE;
+          test.execute( Pop { n } );
+          popped += n;
+        }
+      }
+    }
+
   } catch ( const exception& e ) {
     cerr << "Exception: " << e.what() << endl;
     return EXIT_FAILURE;
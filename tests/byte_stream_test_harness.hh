@@ -55,6 +55,15 @@ struct Pop : public Action<ByteStream>
   void execute( ByteStream& bs ) const override { bs.reader().pop( len_ ); }
 };
 
+struct SetCapacity : public Action<ByteStream>
+{
+  uint64_t capacity_;
+
+  explicit SetCapacity( uint64_t capacity ) : capacity_( capacity ) {}
+  std::string description() const override { return "set_capacity( " + std::to_string( capacity_ ) + " )"; }
+  void execute( ByteStream& bs ) const override { bs.set_capacity( capacity_ ); }
+};
+
 /* expectations */
 
 struct Peek : public Expectation<ByteStream>
@@ -107,6 +116,34 @@ struct PeekOnce : public Peek
   }
 };
 
+struct PeekAt : public Expectation<ByteStream>
+{
+  uint64_t offset_;
+  uint64_t len_;
+  std::string output_;
+
+  PeekAt( uint64_t offset, uint64_t len, std::string output )
+    : offset_( offset ), len_( len ), output_( move( output ) )
+  {}
+
+  std::string description() const override
+  {
+    return "peek( " + std::to_string( offset_ ) + ", " + std::to_string( len_ ) + " ) gives \""
+           + Printer::prettify( output_ ) + "\"";
+  }
+
+  void execute( ByteStream& bs ) const override
+  {
+    std::string got;
+    bs.reader().peek( offset_, len_, got );
+    if ( got != output_ ) {
+      throw ExpectationViolation { "Expected \"" + Printer::prettify( output_ ) + "\" at offset "
+                                   + std::to_string( offset_ ) + ", but found \"" + Printer::prettify( got )
+                                   + "\"" };
+    }
+  }
+};
+
 struct IsClosed : public ConstExpectBool<ByteStream>
 {
   using ConstExpectBool::ConstExpectBool;
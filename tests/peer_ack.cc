@@ -0,0 +1,134 @@
+#include "peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    const string full( 1000, 'x' );
+
+    {
+      TCPConfig cfg;
+      cfg.quick_ack_segments = 0;
+      PeerAndOutput p { cfg };
+      handshake( p );
+
+      p.receive_data( 0, full );
+      p.expect_segments( 0, "first full segment is not ACKed on its own" );
+      p.receive_data( 1000, full );
+      p.expect_ack( 2000, "every second full segment is ACKed" );
+
+      p.receive_data( 2000, "abc" );
+      p.expect_segments( 0, "small segment waits for the delayed ACK timer" );
+      p.tick( cfg.delayed_ack_ms - 1 );
+      p.expect_segments( 0, "delayed ACK timer has not expired" );
+      p.tick( 1 );
+      p.expect_ack( 2003, "delayed ACK timer expired" );
+
+      p.receive_data( 5000, full );
+      p.expect_ack( 2003, "out-of-order segment gets a quick duplicate ACK" );
+      p.receive_data( 2003, string( 2997, 'y' ) );
+      p.expect_ack( 6000, "segment that fills a hole is ACKed immediately" );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.quick_ack_segments = 2;
+      PeerAndOutput p { cfg };
+      handshake( p );
+
+      p.receive_data( 0, full );
+      p.expect_ack( 1000, "quick ACK at connection start" );
+      p.receive_data( 1000, full );
+      p.expect_ack( 2000, "quick ACK at connection start" );
+      p.receive_data( 2000, full );
+      p.expect_segments( 0, "ACK is delayed after the quick ACK segments" );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.quick_ack_segments = 0;
+      cfg.stretch_ack_segments = 4;
+      PeerAndOutput p { cfg };
+      handshake( p );
+
+      for ( uint64_t i = 0; i < 3; i++ ) {
+        p.receive_data( i * 1000, full );
+        p.expect_segments( 0, "stretch ACK holds back" );
+      }
+      p.receive_data( 3000, full );
+      p.expect_ack( 4000, "stretch ACK every fourth full segment" );
+    }
+
+    {
+      TCPConfig cfg;
+      PeerAndOutput p { cfg };
+      handshake( p );
+
+      p.peer.outbound_writer().push( "pong" );
+      p.receive_data( 0, "ping", cfg.isn + 1 );
+      p.expect_segments( 1, "ACK piggybacks on outbound data" );
+      if ( p.output.front().sender.payload != "pong" ) {
+        throw runtime_error( "ACK piggybacks on outbound data: data segment was not sent" );
+      }
+      p.expect_ack( 4, "ACK piggybacks on outbound data" );
+
+      p.receive_data( 4, "ping", cfg.isn + 5 );
+      p.expect_segments( 1, "pure ACK when there is no data to send" );
+      if ( p.output.front().sender.sequence_length() != 0 ) {
+        throw runtime_error( "pure ACK when there is no data to send: segment occupies sequence numbers" );
+      }
+      p.expect_ack( 8, "pure ACK when there is no data to send" );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      cfg.recv_autotune = false;
+      PeerAndOutput p { cfg };
+      handshake( p );
+
+      p.receive_data( 0, string( 4000, 'x' ) );
+      p.expect_ack( 4000, "full buffer" );
+      if ( p.peer.receiver().send().window_size != 0 ) {
+        throw runtime_error( "full buffer: window should be closed" );
+      }
+
+      p.peer.inbound_reader().pop( 500 );
+      p.peer.update_window( p.transmit() );
+      p.expect_segments( 0, "no window update for less than one MSS" );
+      p.peer.inbound_reader().pop( 1500 );
+      p.peer.update_window( p.transmit() );
+      p.expect_segments( 1, "window update once the reader frees enough space" );
+      if ( p.output.front().receiver.window_size != 2000 ) {
+        throw runtime_error( "window update: unexpected window" );
+      }
+      p.expect_ack( 4000, "window update" );
+      p.peer.inbound_reader().pop( 100 );
+      p.tick( 1 );
+      p.expect_segments( 0, "no window update unless the window doubles" );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.delayed_ack = false;
+      PeerAndOutput p { cfg };
+      handshake( p );
+
+      p.receive_data( 0, "a" );
+      p.expect_ack( 1, "without delayed ACKs every segment is ACKed" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
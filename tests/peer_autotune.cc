@@ -0,0 +1,123 @@
+#include "peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+void expect_window( PeerAndOutput& p, uint64_t window, const string& what )
+{
+  const uint64_t actual = p.peer.receiver().send().window_size;
+  if ( actual != window ) {
+    throw runtime_error( what + ": expected window " + to_string( window ) + " but it was " + to_string( actual ) );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      TCPConfig cfg;
+      cfg.recv_autotune = true;
+      cfg.recv_capacity = 4000;
+      cfg.recv_capacity_max = 10000;
+      PeerAndOutput p { cfg };
+      handshake( p );
+
+      // our SYN is acknowledged after 10 ms: that is the RTT
+      p.tick( 10 );
+      p.receive_data( 0, "", cfg.isn + 1 );
+      expect_window( p, 4000, "initial window" );
+
+      // the application reads everything within one RTT: the buffer doubles
+      p.receive_data( 0, string( 4000, 'x' ), cfg.isn + 1 );
+      p.peer.inbound_reader().pop( 4000 );
+      p.tick( 10 );
+      expect_window( p, 8000, "buffer grows to twice what was read in one RTT" );
+
+      p.receive_data( 4000, string( 8000, 'x' ), cfg.isn + 1 );
+      p.peer.inbound_reader().pop( 8000 );
+      p.tick( 10 );
+      expect_window( p, 10000, "buffer growth stops at recv_capacity_max" );
+
+      // the connection goes idle: the buffer shrinks back, but the window already offered is not taken back
+      p.tick( cfg.recv_idle_ms );
+      expect_window( p, 10000, "idle shrink keeps the advertised right edge" );
+
+      // it closes instead as data fills it, down to recv_capacity
+      p.receive_data( 12000, string( 6000, 'x' ), cfg.isn + 1 );
+      expect_window( p, 4000, "the rest of the offered window" );
+      p.peer.inbound_reader().pop( 6000 );
+      expect_window( p, 4000, "reading does not reopen the window past recv_capacity" );
+      p.receive_data( 18000, "", cfg.isn + 1 );
+      if ( p.peer.receiver().writer().capacity() != 4000 ) {
+        throw runtime_error( "idle connection's buffer did not shrink back to recv_capacity" );
+      }
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_autotune = true;
+      cfg.recv_capacity = 40000;
+      cfg.recv_capacity_max = 1 << 20;
+      PeerAndOutput p { cfg };
+      handshake( p );
+      p.tick( 10 );
+      p.receive_data( 0, "", cfg.isn + 1 );
+
+      // without window scaling, a buffer beyond what the window field can advertise would go unused
+      p.receive_data( 0, string( 40000, 'x' ), cfg.isn + 1 );
+      p.peer.inbound_reader().pop( 40000 );
+      p.tick( 10 );
+      expect_window( p, TCPConfig::MAX_WINDOW, "buffer growth stops at the largest window" );
+      if ( p.peer.receiver().writer().capacity() != TCPConfig::MAX_WINDOW ) {
+        throw runtime_error( "receive buffer grew past the largest window" );
+      }
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_autotune = true;
+      cfg.recv_capacity = 4000;
+      cfg.receiver_sws_avoidance = false;
+      PeerAndOutput p { cfg };
+      handshake( p );
+      p.tick( 10 );
+      p.receive_data( 0, "", cfg.isn + 1 );
+
+      // a slow reader does not make the buffer grow
+      p.receive_data( 0, string( 4000, 'x' ), cfg.isn + 1 );
+      p.peer.inbound_reader().pop( 100 );
+      p.tick( 10 );
+      p.tick( 10 );
+      expect_window( p, 100, "slow reader keeps the configured buffer" );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.recv_capacity = 4000;
+      cfg.recv_autotune = false;
+      PeerAndOutput p { cfg };
+      handshake( p );
+      p.tick( 10 );
+      p.receive_data( 0, "", cfg.isn + 1 );
+      p.receive_data( 0, string( 4000, 'x' ), cfg.isn + 1 );
+      p.peer.inbound_reader().pop( 4000 );
+      p.tick( 10 );
+      expect_window( p, 4000, "without auto-tuning the buffer is fixed" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
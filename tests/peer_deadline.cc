@@ -0,0 +1,87 @@
+#include "peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+static void expect_due( const PeerAndOutput& p, optional<uint64_t> ms, const string& what )
+{
+  if ( p.peer.ms_until_next_tick() != ms ) {
+    throw runtime_error( what + ": expected next tick in "
+                         + ( ms.has_value() ? to_string( ms.value() ) + " ms" : string { "never" } ) + " but got "
+                         + ( p.peer.ms_until_next_tick().has_value()
+                               ? to_string( p.peer.ms_until_next_tick().value() ) + " ms"
+                               : string { "never" } ) );
+  }
+}
+
+int main()
+{
+  try {
+    TCPConfig cfg;
+    cfg.quick_ack_segments = 0;
+    cfg.rack_tlp = false;
+    PeerAndOutput p { cfg };
+
+    expect_due( p, nullopt, "nothing scheduled before the connection starts" );
+    handshake( p );
+    expect_due( p, cfg.rt_timeout, "our SYN waits for its retransmission timer" );
+    p.receive( { PEER_ISN + 1, false, {}, false, false }, cfg.isn + 1 );
+    expect_due( p, nullopt, "an idle established connection needs no wakeups" );
+
+    // delayed ACK
+    p.receive_data( 0, "abc" );
+    expect_due( p, cfg.delayed_ack_ms, "delayed ACK timer" );
+    p.tick( cfg.delayed_ack_ms - 1 );
+    expect_due( p, 1, "delayed ACK timer counts down" );
+    p.expect_segments( 0, "delayed ACK timer has not expired" );
+    p.tick( 1 );
+    p.expect_ack( 3, "delayed ACK goes out at its deadline" );
+    expect_due( p, nullopt, "nothing scheduled once the ACK is sent" );
+
+    // retransmission: the deadline is exactly when the segment goes out again
+    p.peer.outbound_writer().push( "hello" );
+    p.peer.push( p.transmit() );
+    p.expect_segments( 1, "data sent" );
+    p.output.clear();
+    const auto rto = p.peer.ms_until_next_tick();
+    if ( not rto.has_value() or rto.value() == 0 ) {
+      throw runtime_error( "outstanding data waits for its retransmission timer" );
+    }
+    p.tick( rto.value() - 1 );
+    p.expect_segments( 0, "retransmission timer has not expired" );
+    p.tick( 1 );
+    p.expect_segments( 1, "data retransmitted at the deadline" );
+    p.output.clear();
+
+    // lingering after both streams finish
+    p.peer.outbound_writer().close();
+    p.peer.push( p.transmit() );
+    p.output.clear();
+    p.receive( { PEER_ISN + 4, false, {}, true, false }, cfg.isn + 7 );
+    p.expect_ack( 4, "FIN acknowledged" );
+    if ( not p.peer.active() ) {
+      throw runtime_error( "the peer that sent its FIN first lingers" );
+    }
+    expect_due( p, 10 * cfg.rt_timeout, "linger deadline" );
+    p.tick( 10 * cfg.rt_timeout - 1 );
+    if ( not p.peer.active() ) {
+      throw runtime_error( "still lingering just before the deadline" );
+    }
+    p.tick( 1 );
+    if ( p.peer.active() ) {
+      throw runtime_error( "done lingering at the deadline" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
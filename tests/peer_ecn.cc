@@ -0,0 +1,118 @@
+#include "common.hh"
+#include "ipv4_header.hh"
+#include "peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// A segment from the remote peer, as the adapter hands it over (ECN codepoint from the IP header)
+static TCPMessage remote( TCPSenderMessage sender, optional<Wrap32> ackno = {}, bool ece = false )
+{
+  return { std::move( sender ), { ackno, 65535, false, ece } };
+}
+
+static TCPSenderMessage remote_data( uint64_t offset, const string& data, uint8_t ecn, bool cwr = false )
+{
+  TCPSenderMessage msg { PEER_ISN + 1 + offset, false, data, false, false };
+  msg.CWR = cwr;
+  msg.ecn = ecn;
+  return msg;
+}
+
+int main()
+{
+  try {
+    const string full( 1000, 'x' );
+
+    {
+      TCPConfig cfg;
+      cfg.ecn = true;
+      cfg.quick_ack_segments = 0;
+      PeerAndOutput p { cfg };
+
+      TCPSenderMessage syn { PEER_ISN, true, {}, false, false };
+      syn.CWR = true;
+      p.peer.receive( remote( syn, {}, true ), p.transmit() );
+      p.expect_segments( 1, "SYN-ACK" );
+      expect( p.output.front().receiver.ECE and not p.output.front().sender.CWR, "SYN-ACK agrees to ECN" );
+      p.output.clear();
+
+      p.peer.receive( remote( remote_data( 0, full, IPv4Header::ECN_CE ) ), p.transmit() );
+      p.expect_segments( 1, "CE-marked segment is ACKed immediately" );
+      expect( p.output.front().receiver.ECE, "ACK echoes the CE mark" );
+      p.output.clear();
+
+      p.peer.receive( remote( remote_data( 1000, full, IPv4Header::ECN_ECT0 ) ), p.transmit() );
+      p.peer.receive( remote( remote_data( 2000, full, IPv4Header::ECN_ECT0 ) ), p.transmit() );
+      p.expect_segments( 1, "every second full segment is ACKed" );
+      expect( p.output.front().receiver.ECE, "ECE is repeated until the sender answers with CWR" );
+      p.output.clear();
+
+      p.peer.receive( remote( remote_data( 3000, full, IPv4Header::ECN_ECT0, true ) ), p.transmit() );
+      p.peer.receive( remote( remote_data( 4000, full, IPv4Header::ECN_ECT0 ) ), p.transmit() );
+      p.expect_segments( 1, "every second full segment is ACKed" );
+      expect( not p.output.front().receiver.ECE, "CWR stops the ECN-Echo" );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.ecn = true;
+      PeerAndOutput p { cfg };
+      handshake( p );
+      p.peer.receive( remote( remote_data( 0, full, IPv4Header::ECN_CE ) ), p.transmit() );
+      p.expect_segments( 1, "quick ACK" );
+      expect( not p.output.front().receiver.ECE, "no ECN-Echo unless ECN was negotiated" );
+    }
+
+    {
+      TCPConfig cfg;
+      cfg.ecn = true;
+      cfg.pacing = false;
+      cfg.gso = false;
+      PeerAndOutput p { cfg };
+
+      p.peer.push( p.transmit() );
+      p.expect_segments( 1, "SYN" );
+      expect( p.output.front().receiver.ECE and p.output.front().sender.CWR, "SYN asks for ECN" );
+      const Wrap32 isn = p.output.front().sender.seqno;
+      p.output.clear();
+
+      p.peer.receive( remote( { PEER_ISN, true, {}, false, false }, isn + 1, true ), p.transmit() );
+      expect( p.peer.sender().cwnd() == 10 * TCPConfig::MAX_PAYLOAD_SIZE, "SYN-ACK's ECE is not a congestion signal" );
+      p.output.clear();
+
+      p.peer.outbound_writer().push( string( 4000, 'y' ) );
+      p.peer.push( p.transmit() );
+      p.expect_segments( 4, "data" );
+      expect( p.output.front().sender.ecn == IPv4Header::ECN_ECT0, "data is ECN-capable" );
+      p.output.clear();
+
+      p.peer.receive( remote( { PEER_ISN + 1, false, {}, false, false }, isn + 1001, true ), p.transmit() );
+      expect( p.peer.sender().cwnd() == 2000, "ECN-Echo halves the window" );
+      p.peer.outbound_writer().push( string( 1000, 'z' ) );
+      p.peer.push( p.transmit() );
+      expect( p.output.empty(), "the halved window is full" );
+      p.peer.receive( remote( { PEER_ISN + 1, false, {}, false, false }, isn + 4001 ), p.transmit() );
+      expect( not p.output.empty() and p.output.front().sender.CWR, "next new data carries CWR" );
+    }
+
+    {
+      const TCPConfig cfg;
+      PeerAndOutput p { cfg };
+      p.peer.push( p.transmit() );
+      p.expect_segments( 1, "SYN" );
+      expect( not p.output.front().receiver.ECE and not p.output.front().sender.CWR, "ECN is off by default" );
+      expect( p.output.front().sender.ecn == 0, "SYN is not ECN-capable" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+#include "common.hh"
+#include "peer_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static void expect_state( const PeerAndOutput& p, TCPInfo::State state, const string& what )
+{
+  const TCPInfo info = p.peer.info();
+  expect( info.state == state,
+          what + ": expected " + to_string( state ) + " but the state was " + to_string( info.state ) );
+}
+
+int main()
+{
+  try {
+    TCPConfig cfg;
+    cfg.rt_timeout = 100;
+    cfg.pacing = false;
+
+    // Active open
+    PeerAndOutput p { cfg };
+    expect_state( p, TCPInfo::State::listen, "fresh peer" );
+    p.peer.push( p.transmit() );
+    const Wrap32 isn = p.output.front().sender.seqno;
+    p.output.clear();
+    expect_state( p, TCPInfo::State::syn_sent, "SYN sent" );
+    expect( p.peer.info().segments_out == 1, "the SYN is counted" );
+
+    p.tick( 10 );
+    p.receive( { PEER_ISN, true, {}, false, false }, isn + 1 );
+    p.output.clear();
+    TCPInfo info = p.peer.info();
+    expect( info.state == TCPInfo::State::established, "handshake done" );
+    expect( info.segments_in == 1 and info.segments_out == 2, "SYN-ACK in, ACK out" );
+    expect( info.srtt_ms == 10 and info.min_rtt_ms == 10, "RTT measured from the handshake" );
+    expect( info.mss == TCPConfig::MAX_PAYLOAD_SIZE and info.cwnd == 10 * info.mss, "initial window" );
+    expect( info.rwnd_limited_ms + info.cwnd_limited_ms + info.app_limited_ms == 0, "nothing limited yet" );
+
+    // Limited by the congestion window, then by the peer's window, then by the application
+    p.peer.outbound_writer().push( string( 12000, 'x' ) );
+    p.peer.push( p.transmit() );
+    p.tick( 5 );
+    expect( p.peer.info().cwnd_limited_ms == 5, "the flight filled the congestion window" );
+    expect( p.peer.info().bytes_sent == 10000, "one congestion window sent" );
+
+    p.peer.receive( { { PEER_ISN + 1, false, {}, false, false }, { isn + 1 + 10000, 1000 } }, p.transmit() );
+    p.tick( 7 );
+    info = p.peer.info();
+    expect( info.rwnd_limited_ms == 7, "the flight filled the peer's window" );
+    expect( info.send_window == 1000, "the peer's window" );
+    expect( info.bytes_sent == 11000 and info.bytes_acked == 10000, "bytes sent and acknowledged" );
+
+    p.receive( { PEER_ISN + 1, false, {}, false, false }, isn + 1 + 11000 );
+    p.receive( { PEER_ISN + 1, false, {}, false, false }, isn + 1 + 12000 );
+    p.tick( 3 );
+    info = p.peer.info();
+    expect( info.app_limited_ms == 3, "nothing more to send" );
+    expect( info.bytes_sent == 12000 and info.bytes_acked == 12000 and info.bytes_in_flight == 0, "all acked" );
+    expect( info.cwnd_limited_ms == 5 and info.rwnd_limited_ms == 7, "earlier limits are kept" );
+
+    // A retransmission
+    p.peer.outbound_writer().push( string( 500, 'y' ) );
+    p.peer.push( p.transmit() );
+    p.tick( 100 );
+    info = p.peer.info();
+    expect( info.retransmissions == 1 and info.bytes_retransmitted == 500, "the timeout retransmitted" );
+    expect( info.rto_ms == 200, "the timer backed off" );
+    expect( info.bytes_sent == 12500, "retransmitted bytes are not sent bytes" );
+    p.receive( { PEER_ISN + 1, false, {}, false, false }, isn + 1 + 12500 );
+
+    // Inbound: in order, out of order, duplicate
+    p.receive_data( 0, "abc" );
+    p.receive_data( 5, "fg" );
+    p.receive_data( 0, "abc" );
+    p.receive_data( 3, "de" );
+    info = p.peer.info();
+    expect( info.bytes_received == 7, "bytes received in order" );
+    expect( info.out_of_order_segments == 1, "one segment arrived beyond a hole" );
+    expect( info.duplicate_segments == 1, "one segment carried nothing new" );
+    expect( info.receive_window == p.output.back().receiver.window_size, "the window we advertised" );
+    p.output.clear();
+
+    // Active close
+    p.peer.outbound_writer().close();
+    p.peer.push( p.transmit() );
+    expect_state( p, TCPInfo::State::fin_wait_1, "FIN sent" );
+    p.receive( { PEER_ISN + 8, false, {}, false, false }, isn + 1 + 12500 + 1 );
+    expect_state( p, TCPInfo::State::fin_wait_2, "FIN acknowledged" );
+    p.receive( { PEER_ISN + 8, false, {}, true, false }, isn + 1 + 12500 + 1 );
+    expect_state( p, TCPInfo::State::time_wait, "the peer closed too" );
+    p.tick( 10UL * cfg.rt_timeout );
+    expect_state( p, TCPInfo::State::closed, "done lingering" );
+    expect( p.peer.info().to_string().starts_with( "CLOSED sent=12500" ), "summary" );
+
+    // Passive close
+    PeerAndOutput q { cfg };
+    handshake( q );
+    expect_state( q, TCPInfo::State::syn_received, "SYN received" );
+    const Wrap32 q_isn = cfg.isn;
+    q.receive( { PEER_ISN + 1, false, {}, false, false }, q_isn + 1 );
+    expect_state( q, TCPInfo::State::established, "SYN-ACK acknowledged" );
+    q.receive( { PEER_ISN + 1, false, {}, true, false }, q_isn + 1 );
+    expect_state( q, TCPInfo::State::close_wait, "the peer closed" );
+    q.peer.outbound_writer().close();
+    q.peer.push( q.transmit() );
+    expect_state( q, TCPInfo::State::last_ack, "FIN sent" );
+    q.receive( { PEER_ISN + 2, false, {}, false, false }, q_isn + 2 );
+    q.tick( 10UL * cfg.rt_timeout );
+    expect_state( q, TCPInfo::State::closed, "FIN acknowledged" );
+
+    // Reset
+    PeerAndOutput r { cfg };
+    handshake( r );
+    r.receive( { PEER_ISN + 1, false, {}, false, true } );
+    expect_state( r, TCPInfo::State::reset, "RST received" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+#include "common.hh"
+#include "peer_test_harness.hh"
+#include "tcp_metrics.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Send our SYN, and report how long it takes to be retransmitted
+static uint64_t syn_retransmission_ms( const TCPConfig& cfg )
+{
+  PeerAndOutput p { cfg };
+  p.peer.push( p.transmit() );
+  p.expect_segments( 1, "SYN" );
+  p.output.clear();
+  for ( uint64_t ms = 1; ms <= cfg.rt_timeout; ms++ ) {
+    p.tick( 1 );
+    if ( not p.output.empty() ) {
+      return ms;
+    }
+  }
+  throw runtime_error( "SYN was not retransmitted" );
+}
+
+int main()
+{
+  try {
+    // A connection measures the path...
+    TCPMetrics measured;
+    {
+      TCPConfig cfg;
+      PeerAndOutput p { cfg };
+      expect( not p.peer.sender().metrics().has_value(), "nothing measured before the first RTT sample" );
+      p.peer.push( p.transmit() );
+      const Wrap32 isn = p.output.front().sender.seqno;
+      p.output.clear();
+      p.tick( 300 );
+      p.receive( { PEER_ISN, true, {}, false, false }, isn + 1 );
+      expect( p.peer.sender().metrics().has_value(), "RTT measured from the handshake" );
+      measured = p.peer.sender().metrics().value();
+      expect( measured.srtt_ms == 300 and measured.rttvar_ms == 150 and measured.min_rtt_ms == 300, "RTT estimate" );
+      expect( measured.ssthresh == 0, "never left slow start" );
+    }
+
+    // ... which is kept per destination IPv4 address ...
+    cache_tcp_metrics( Address { "10.144.0.1", 80 }, measured );
+    expect( cached_tcp_metrics( Address { "10.144.0.1", 443 } ).has_value(), "metrics are kept per address" );
+    expect( not cached_tcp_metrics( Address { "10.144.0.2", 80 } ).has_value(), "other destinations start cold" );
+
+    // ... and the next connection starts from it
+    {
+      TCPConfig cfg;
+      cfg.metrics = cached_tcp_metrics( Address { "10.144.0.1", 80 } );
+      expect( syn_retransmission_ms( cfg ) == 900, "RTO is SRTT + 4 * RTTVAR instead of rt_timeout" );
+
+      cfg.metrics = TCPMetrics { .srtt_ms = 2, .rttvar_ms = 1, .min_rtt_ms = 2, .ssthresh = 20000 };
+      expect( syn_retransmission_ms( cfg ) == 200, "RTO from cached metrics is at least 200 ms" );
+      cfg.rt_timeout = 100;
+      expect( syn_retransmission_ms( cfg ) == 100, "... unless rt_timeout is smaller" );
+
+      PeerAndOutput p { cfg };
+      expect( p.peer.sender().ssthresh() == 20000, "slow-start threshold is seeded" );
+      expect( p.peer.sender().rtt().srtt_ms() == 2, "RTT estimate is seeded" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
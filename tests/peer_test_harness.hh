@@ -0,0 +1,64 @@
+#pragma once
+
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Drives one TCPPeer with segments from a simulated remote peer, and records what it sends back.
+
+const Wrap32 PEER_ISN { 1000 };
+
+struct PeerAndOutput
+{
+  TCPPeer peer;
+  std::vector<TCPMessage> output {};
+
+  explicit PeerAndOutput( const TCPConfig& cfg ) : peer( cfg ) {}
+
+  auto transmit()
+  {
+    return [&]( const TCPMessage& msg ) { output.push_back( msg ); };
+  }
+
+  // Receive a segment from the (simulated) remote peer
+  void receive( TCPSenderMessage msg, std::optional<Wrap32> ackno = {} )
+  {
+    peer.receive( { std::move( msg ), { ackno, 65535 } }, transmit() );
+  }
+
+  void receive_data( uint64_t offset, const std::string& data, std::optional<Wrap32> ackno = {} )
+  {
+    receive( { PEER_ISN + 1 + offset, false, data, false, false }, ackno );
+  }
+
+  void tick( uint64_t ms ) { peer.tick( ms, transmit() ); }
+
+  void expect_segments( size_t count, const std::string& what )
+  {
+    if ( output.size() != count ) {
+      throw std::runtime_error( what + ": expected " + std::to_string( count ) + " segments but "
+                                + std::to_string( output.size() ) + " were sent" );
+    }
+  }
+
+  void expect_ack( uint64_t offset, const std::string& what )
+  {
+    expect_segments( 1, what );
+    if ( output.front().receiver.ackno != PEER_ISN + 1 + offset ) {
+      throw std::runtime_error( what + ": unexpected ackno" );
+    }
+    output.clear();
+  }
+};
+
+// Handshake: the remote peer's SYN is acknowledged immediately, on our own SYN
+inline void handshake( PeerAndOutput& p )
+{
+  p.receive( { PEER_ISN, true, {}, false, false } );
+  p.expect_ack( 0, "SYN" );
+}
@@ -0,0 +1,121 @@
+#include "common.hh"
+#include "parser.hh"
+#include "peer_test_harness.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+static const string COOKIE { "\x01\x02\x03\x04\x05\x06\x07\x08", 8 };
+
+static TCPSenderMessage syn( const string& data, optional<string> cookie )
+{
+  TCPSenderMessage msg { PEER_ISN, true, data, false, false };
+  msg.fastopen_cookie = std::move( cookie );
+  return msg;
+}
+
+int main()
+{
+  try {
+    // The cookie option survives the wire, padded to a 32-bit boundary
+    for ( const string& cookie : { string {}, COOKIE } ) {
+      TCPSegment seg;
+      seg.message.sender = syn( "GET /", cookie );
+      seg.message.sender.mss = 1460;
+      seg.compute_checksum( 0 );
+      expect( seg.header_length() % 4 == 0, "options are padded" );
+
+      TCPSegment parsed;
+      expect( parse( parsed, serialize( seg ), 0 ), "segment with a cookie option parses" );
+      expect( parsed.message.sender.fastopen_cookie == cookie, "cookie option round-trips" );
+      expect( parsed.message.sender.mss == 1460, "MSS option round-trips" );
+      expect( parsed.message.sender.payload == "GET /", "payload follows the options" );
+    }
+
+    // Server: SYN data with the issued cookie reaches the application before the handshake completes
+    {
+      TCPConfig cfg;
+      cfg.fastopen = true;
+      PeerAndOutput p { cfg };
+      p.peer.issue_fastopen_cookie( COOKIE );
+      p.receive( syn( "GET /", COOKIE ) );
+      expect( p.peer.inbound_reader().peek() == "GET /", "SYN data is accepted" );
+      expect( not p.output.empty() and not p.output.front().sender.fastopen_cookie.has_value(),
+              "no cookie offered to a client that has one" );
+      p.expect_ack( 5, "SYN-ACK acknowledges the SYN data" );
+    }
+
+    // Server: without a valid cookie, only the SYN is accepted and a cookie is offered
+    for ( const auto& [data, cookie] : { pair<string, string> { "GET /", "wrong!!!" }, { "", "" } } ) {
+      TCPConfig cfg;
+      cfg.fastopen = true;
+      PeerAndOutput p { cfg };
+      p.peer.issue_fastopen_cookie( COOKIE );
+      p.receive( syn( data, cookie ) );
+      expect( p.peer.inbound_reader().bytes_buffered() == 0, "SYN data without a valid cookie is dropped" );
+      expect( not p.output.empty() and p.output.front().sender.fastopen_cookie == COOKIE, "cookie is offered" );
+      p.expect_ack( 0, "SYN-ACK acknowledges only the SYN" );
+    }
+
+    // Server: SYN data without the Fast Open option is dropped too, and no cookie is offered unasked
+    {
+      TCPConfig cfg;
+      cfg.fastopen = true;
+      PeerAndOutput p { cfg };
+      p.peer.issue_fastopen_cookie( COOKIE );
+      p.receive( syn( "GET /", nullopt ) );
+      expect( p.peer.inbound_reader().bytes_buffered() == 0, "SYN data without a cookie is dropped" );
+      expect( not p.output.empty() and not p.output.front().sender.fastopen_cookie.has_value(),
+              "no cookie offered to a client that did not ask" );
+      p.expect_ack( 0, "SYN-ACK acknowledges only the SYN" );
+    }
+
+    // Client: without a cookie, the SYN asks for one and carries no data
+    {
+      TCPConfig cfg;
+      cfg.fastopen = true;
+      PeerAndOutput p { cfg };
+      p.peer.outbound_writer().push( "GET /" );
+      p.peer.push( p.transmit() );
+      p.expect_segments( 1, "SYN" );
+      expect( p.output.front().sender.fastopen_cookie == "", "SYN asks for a cookie" );
+      expect( p.output.front().sender.payload.empty(), "no data on the SYN without a cookie" );
+      const Wrap32 isn = p.output.front().sender.seqno;
+      p.output.clear();
+
+      p.receive( syn( "", COOKIE ), isn + 1 );
+      expect( p.peer.received_fastopen_cookie() == COOKIE, "cookie from the SYN-ACK is kept" );
+    }
+
+    // Client: with a cookie, the SYN carries the data; if the server drops it, it is sent again at once
+    {
+      TCPConfig cfg;
+      cfg.fastopen = true;
+      cfg.fastopen_cookie = COOKIE;
+      PeerAndOutput p { cfg };
+      p.peer.outbound_writer().push( "GET /" );
+      p.peer.push( p.transmit() );
+      p.expect_segments( 1, "SYN" );
+      expect( p.output.front().sender.fastopen_cookie == COOKIE, "SYN presents the cookie" );
+      expect( p.output.front().sender.payload == "GET /", "SYN carries the data" );
+      const Wrap32 isn = p.output.front().sender.seqno;
+      p.output.clear();
+
+      p.receive( syn( "", COOKIE ), isn + 1 );
+      expect( not p.output.empty() and p.output.front().sender.seqno == isn + 1
+                and p.output.front().sender.payload == "GET /",
+              "data the server dropped is sent again without waiting for a timeout" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
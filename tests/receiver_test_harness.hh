@@ -61,6 +61,21 @@ public:
   using TestHarness<TCPReceiver>::execute;
 };
 
+struct SetSWSAvoidance : public Action<TCPReceiver>
+{
+  uint64_t mss_;
+
+  explicit SetSWSAvoidance( uint64_t mss ) : mss_( mss ) {}
+  std::string description() const override { return "set_sws_avoidance( " + std::to_string( mss_ ) + " )"; }
+  void execute( TCPReceiver& rs ) const override { rs.set_sws_avoidance( mss_ ); }
+};
+
+struct Advertise : public Action<TCPReceiver>
+{
+  std::string description() const override { return "advertise( send() )"; }
+  void execute( TCPReceiver& rs ) const override { rs.advertise( rs.send() ); }
+};
+
 struct ExpectWindow : public ExpectNumber<TCPReceiver, uint16_t>
 {
   using ExpectNumber::ExpectNumber;
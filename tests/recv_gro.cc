@@ -0,0 +1,81 @@
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+TCPMessage data_segment( uint32_t seqno, const string& payload, uint32_t ackno = 500, uint16_t window = 1000 )
+{
+  return { .sender = { .seqno = Wrap32 { seqno }, .payload = payload }, .receiver = { Wrap32 { ackno }, window } };
+}
+
+void expect( bool condition, const string& what )
+{
+  if ( not condition ) {
+    throw runtime_error( "coalesce_gro: " + what );
+  }
+}
+
+} // namespace
+
+int main()
+{
+  try {
+    {
+      vector<TCPMessage> burst { data_segment( 100, "abc" ), data_segment( 103, "def" ), data_segment( 106, "g" ) };
+      burst.back().sender.FIN = true;
+      const auto merged = coalesce_gro( burst );
+      expect( merged.size() == 1, "in-sequence segments are merged into one" );
+      expect( merged.front().sender.seqno == Wrap32 { 100 }, "merged segment starts at the first seqno" );
+      expect( merged.front().sender.payload == "abcdefg", "merged payload is the concatenation" );
+      expect( merged.front().sender.FIN, "FIN of the last segment is kept" );
+      expect( merged.front().sender.gso_size == 3, "gso_size records the wire segment size" );
+    }
+
+    {
+      const vector<TCPMessage> burst { data_segment( 100, "abc" ), data_segment( 200, "def" ) };
+      expect( coalesce_gro( burst ).size() == 2, "a gap stops merging" );
+    }
+
+    {
+      const vector<TCPMessage> burst { data_segment( 100, "abc" ), data_segment( 103, "def", 501 ) };
+      expect( coalesce_gro( burst ).size() == 2, "a different ackno stops merging" );
+    }
+
+    {
+      const vector<TCPMessage> burst { data_segment( 100, "abc" ), data_segment( 103, "def", 500, 999 ) };
+      expect( coalesce_gro( burst ).size() == 2, "a window update stops merging" );
+    }
+
+    {
+      const vector<TCPMessage> burst { data_segment( 100, "" ), data_segment( 100, "" ) };
+      expect( coalesce_gro( burst ).size() == 2, "pure (duplicate) ACKs are not merged" );
+    }
+
+    {
+      vector<TCPMessage> burst { data_segment( 100, "abc" ), data_segment( 103, "def" ), data_segment( 106, "g" ) };
+      burst.at( 1 ).sender.FIN = true;
+      expect( coalesce_gro( burst ).size() == 2, "nothing is merged after a FIN" );
+    }
+
+    {
+      const vector<TCPMessage> pieces = split_gso(
+        { .sender = { .seqno = Wrap32 { 7 }, .payload = string( 3000, 'x' ), .gso_size = 1000 }, .receiver = {} } );
+      const auto merged = coalesce_gro( pieces );
+      expect( merged.size() == 1 and merged.front().sender.payload.size() == 3000, "GRO undoes GSO" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
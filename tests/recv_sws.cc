@@ -0,0 +1,95 @@
+#include "receiver_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    {
+      const size_t cap = 4000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "window opens only by at least one MSS", cap };
+      test.execute( SetSWSAvoidance { 1000 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( ExpectWindow { cap } );
+      test.execute( Advertise {} );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( ExpectAckno { Wrap32 { isn + 1 + cap } } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Advertise {} );
+      test.execute( Pop { 500 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Advertise {} );
+      test.execute( Pop { 499 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Advertise {} );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Advertise {} );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Advertise {} );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 + cap ).with_data( "abc" ) );
+      test.execute( ExpectWindow { 997 } );
+      test.execute( Advertise {} );
+      test.execute( Pop { 2999 } );
+      test.execute( ExpectWindow { cap - 3 } );
+    }
+
+    {
+      const size_t cap = 1000;
+      const uint32_t isn = 1;
+      TCPReceiverTestHarness test { "small buffer opens by half its size", cap };
+      test.execute( SetSWSAvoidance { 1460 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( Advertise {} );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Advertise {} );
+      test.execute( Pop { 499 } );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 500 } );
+    }
+
+    {
+      const size_t cap = 4000;
+      const uint32_t isn = 7;
+      TCPReceiverTestHarness test { "only transmitted windows hold back the right edge", cap };
+      test.execute( SetSWSAvoidance { 1000 } );
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( Advertise {} );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( Pop { 1000 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( ExpectWindow { 1000 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 1001 } );
+      test.execute( Advertise {} );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 1001 } );
+    }
+
+    {
+      const size_t cap = 4000;
+      const uint32_t isn = 23452;
+      TCPReceiverTestHarness test { "without SWS avoidance every byte opens the window", cap };
+      test.execute( SegmentArrives {}.with_syn().with_seqno( isn ) );
+      test.execute( SegmentArrives {}.with_seqno( isn + 1 ).with_data( string( cap, 'x' ) ) );
+      test.execute( ExpectWindow { 0 } );
+      test.execute( Pop { 1 } );
+      test.execute( ExpectWindow { 1 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
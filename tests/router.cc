@@ -7,6 +7,7 @@
 #include <list>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 using namespace std;
 
@@ -94,9 +95,10 @@ public:
     , _next_hop( next_hop )
   {}
 
-  InternetDatagram send_to( const Address& destination, const uint8_t ttl = 64 )
+  InternetDatagram send_to( const Address& destination, const uint8_t ttl = 64, const uint8_t tos = 0 )
   {
     InternetDatagram dgram;
+    dgram.header.tos = tos;
     dgram.header.src = _my_address.ipv4_numeric();
     dgram.header.dst = destination.ipv4_numeric();
     dgram.payload.emplace_back( string { "Cardinal " + to_string( random_device()() % 1000 ) } );
@@ -220,6 +222,8 @@ public:
     _router.add_route( ip( "128.30.76.255" ), 16, Address { "128.30.0.1" }, mit5_id );
   }
 
+  void set_ecn_threshold( size_t datagrams ) { _router.set_ecn_threshold( datagrams ); }
+
   void simulate()
   {
     for ( unsigned int i = 0; i < 256; i++ ) {
@@ -327,6 +331,29 @@ void network_simulator()
     network.simulate();
   }
 
+  cout << green << "\n\nSuccess! Testing ECN marking past the queue threshold..." << normal << "\n\n";
+  {
+    // the datagrams arrive together, so one route() forwards all five to the same interface
+    network.set_ecn_threshold( 2 );
+    const vector<pair<uint8_t, bool>> datagrams { // (ECN codepoint, whether the router marks it CE)
+      { IPv4Header::ECN_ECT0, false },            // under the threshold
+      { 0, false },                               // under the threshold
+      { 0, false },                               // past it, but not ECN-capable
+      { IPv4Header::ECN_ECT0, true },
+      { IPv4Header::ECN_ECT1, true } };
+    for ( const auto& [ecn, marked] : datagrams ) {
+      auto dgram_sent = network.host( "applesauce" ).send_to( network.host( "cherrypie" ).address(), 64, ecn );
+      dgram_sent.header.ttl--;
+      if ( marked ) {
+        dgram_sent.header.tos |= IPv4Header::ECN_CE;
+      }
+      dgram_sent.header.compute_checksum();
+      network.host( "cherrypie" ).expect( dgram_sent );
+    }
+    network.simulate();
+    network.set_ecn_threshold( 0 );
+  }
+
   cout << "\n\n\033[32;1mCongratulations! All datagrams were routed successfully.\033[m\n";
 }
 
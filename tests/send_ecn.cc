@@ -0,0 +1,114 @@
+#include "ipv4_header.hh"
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Congestion window starts at ten segments and grows in slow start", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      for ( unsigned int i = 0; i < 10; i++ ) {
+        test.execute( AckReceived { isn }.with_win( 60000 ) ); // acknowledges nothing, not even the SYN
+      }
+      test.execute( ExpectCongestionWindow { 10000 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60000 ) );
+      test.execute( Push { string( 20000, 'x' ) } );
+      for ( unsigned int i = 0; i < 10; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 + 1000 * i ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCongestionWindow { 10000 } );
+      test.execute( AckReceived { Wrap32 { isn + 2001 } }.with_win( 60000 ) );
+      test.execute( ExpectCongestionWindow { 12000 } );
+      for ( unsigned int i = 10; i < 14; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 + 1000 * i ) );
+      }
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 12000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "ECN-Echo halves the window once per flight, then CWR goes out", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( SetECN {} );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ).with_ecn( 0 ).with_cwr( false ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60000 ) );
+      test.execute( Push { string( 20000, 'x' ) } );
+      for ( unsigned int i = 0; i < 10; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_ecn( IPv4Header::ECN_ECT0 ).with_cwr( false ) );
+      }
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 60000 ).with_ece() );
+      test.execute( ExpectCongestionWindow { 4500 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 2001 } }.with_win( 60000 ).with_ece() );
+      test.execute( ExpectCongestionWindow { 4500 } );
+      test.execute( ExpectNoSegment {} );
+
+      test.execute( AckReceived { Wrap32 { isn + 10001 } }.with_win( 60000 ) );
+      test.execute( ExpectCongestionWindow { 5500 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 10001 ).with_cwr( true ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 11001 ).with_cwr( false ) );
+      test.execute( ExpectSeqnosInFlight { 5500 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Timeout restarts slow start; retransmissions are not ECN-capable", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( SetECN {} );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 60000 ) );
+      test.execute( Push { string( 3000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_ecn( IPv4Header::ECN_ECT0 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_ecn( IPv4Header::ECN_ECT0 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_ecn( IPv4Header::ECN_ECT0 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ).with_ecn( 0 ) );
+      test.execute( ExpectCongestionWindow { 1000 } );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 60000 ) );
+      test.execute( ExpectCongestionWindow { 2000 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -663,6 +663,24 @@ int main()
       test.execute( ExpectMessage {}.with_syn( true ).with_fin( true ).with_payload_size( 0 ).with_seqno( isn ) );
       test.execute( ExpectNoSegment {} );
     }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.send_capacity = 10;
+
+      TCPSenderTestHarness test { "Unacknowledged bytes take up the outbound stream's capacity", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 100 ) );
+      test.execute( Push { "0123456789" } );
+      test.execute( ExpectMessage {}.with_data( "0123456789" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectSeqnosInFlight { 10 } );
+      test.execute( ExpectAvailableCapacity { 0 } );
+      test.execute( AckReceived { Wrap32 { isn + 11 } }.with_win( 100 ) );
+      test.execute( ExpectAvailableCapacity { 10 } );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << endl;
     return 1;
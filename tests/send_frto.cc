@@ -0,0 +1,115 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "F-RTO: ACK for never-retransmitted data marks the timeout spurious", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 3000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectConsecutiveRetransmissions { 1 } );
+
+      // The first ACK covers the retransmission: new data goes out instead of more retransmissions
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 3000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 3001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSpuriousTimeouts { 0 } );
+
+      // The second ACK covers a segment that was only sent once: the original flight arrived
+      test.execute( AckReceived { Wrap32 { isn + 2001 } }.with_win( 3000 ) );
+      test.execute( ExpectSpuriousTimeouts { 1 } );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 4001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.rt_timeout - 1U } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "F-RTO: duplicate ACK confirms the timeout and resends the next hole", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 3000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2001 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 3000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 3001 ) );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 3000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSpuriousTimeouts { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "F-RTO: an ACK for the whole flight is ambiguous", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 2000 ) );
+      test.execute( Push { string( 2000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 2001 } }.with_win( 2000 ) );
+      test.execute( Push { string( 1000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2001 ) );
+      test.execute( AckReceived { Wrap32 { isn + 3001 } }.with_win( 2000 ) );
+      test.execute( ExpectSpuriousTimeouts { 0 } );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
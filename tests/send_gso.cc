@@ -0,0 +1,131 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+#include "tcp_segment.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = true;
+      cfg.pacing = false;
+
+      TCPSenderTestHarness test { "GSO sends the window as one super-segment, retransmits one MSS", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 5000 ).with_gso_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 5000 } );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_gso_size( 0 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 10000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 4000 } );
+      test.execute( AckReceived { Wrap32 { isn + 5001 } }.with_win( 10000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = true;
+      cfg.pacing = false;
+
+      TCPSenderTestHarness test { "GSO super-segment is limited by the window", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 2500 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 2500 ).with_gso_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = true;
+      cfg.pacing = true;
+      cfg.pacing_rate_cap = 1'000'000; // 1000 bytes per ms
+
+      TCPSenderTestHarness test { "GSO super-segment is limited by the pacing budget", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 2000 ).with_gso_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_gso_size( 0 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 2 } );
+      test.execute( ExpectMessage {}.with_payload_size( 2000 ).with_gso_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = true;
+      cfg.pacing = false;
+      cfg.mtu_probing = true;
+
+      // (gso_size 0 means split_gso hands the adapter the probe as one datagram)
+      TCPSenderTestHarness test { "An MTU probe larger than the MSS is not cut into MSS-sized pieces", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { TCPConfig::DEFAULT_MSS } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1230 ).with_gso_size( 0 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 3770 ).with_gso_size( 1000 ).with_seqno( isn + 1231 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPMessage super;
+      super.sender = { .seqno = Wrap32 { 10 }, .payload = string( 2500, 'x' ), .FIN = true, .gso_size = 1000 };
+      super.receiver = { Wrap32 { 77 }, 1234 };
+
+      const auto pieces = split_gso( super );
+      if ( pieces.size() != 3 ) {
+        throw runtime_error( "split_gso: expected 3 pieces, got " + to_string( pieces.size() ) );
+      }
+      for ( size_t i = 0; i < pieces.size(); i++ ) {
+        const auto& piece = pieces.at( i );
+        if ( piece.sender.seqno != Wrap32 { static_cast<uint32_t>( 10 + i * 1000 ) }
+             or piece.sender.payload.size() != ( i == 2 ? 500 : 1000 ) or piece.sender.FIN != ( i == 2 )
+             or piece.sender.gso_size != 0 or piece.receiver.ackno != Wrap32 { 77 } ) {
+          throw runtime_error( "split_gso: piece " + to_string( i ) + " is wrong" );
+        }
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "Negotiated MSS sets the payload size", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { TCPConfig::DEFAULT_MSS } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+      test.execute( Push { string( 3000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::DEFAULT_MSS ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( TCPConfig::DEFAULT_MSS ) );
+      test.execute( ExpectMessage {}.with_payload_size( 3000 - 2 * TCPConfig::DEFAULT_MSS ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 3000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+
+      TCPSenderTestHarness test { "A small MSS is respected", cfg };
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { 536 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { string( 1000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 536 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 464 ).with_seqno( isn + 537 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    for ( const uint64_t announced : { 0, 1, 87 } ) {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = true;
+
+      TCPSenderTestHarness test { "An MSS of " + to_string( announced ) + " is raised to the minimum", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { announced } );
+      test.execute( ExpectCongestionWindow { 10 * TCPConfig::MIN_MSS } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { string( 200, 'z' ) } );
+      test.execute(
+        ExpectMessage {}.with_payload_size( 200 ).with_gso_size( TCPConfig::MIN_MSS ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.mtu_probing = true;
+
+      TCPSenderTestHarness test { "An MTU probe is sent as one full segment", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { TCPConfig::DEFAULT_MSS } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1230 ).with_gso_size( 0 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1231 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 770 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.mtu_probing = true;
+
+      TCPSenderTestHarness test { "An acknowledged MTU probe raises the MSS", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { TCPConfig::DEFAULT_MSS } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 2230, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1230 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1231 ) );
+      test.execute( AckReceived { Wrap32 { isn + 2231 } }.with_win( 10000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+
+      // the next probe searches above the new MSS, and the other segments are now the probed size
+      test.execute( Push { string( 4000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1345 ).with_seqno( isn + 2231 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1230 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1230 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 195 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.mtu_probing = true;
+
+      TCPSenderTestHarness test { "A lost MTU probe is resent as MSS-sized segments and lowers the ceiling", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { TCPConfig::DEFAULT_MSS } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 2230, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1230 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1231 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } ); // (a lost probe is not congestion: no backoff)
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 10000 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 230 ).with_seqno( isn + 1001 ) );
+      test.execute( AckReceived { Wrap32 { isn + 2231 } }.with_win( 10000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+
+      // the MSS stays, and the next probe searches below the size that was lost
+      test.execute( Push { string( 2000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1115 ).with_seqno( isn + 2231 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 885 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.mtu_probing = true;
+
+      TCPSenderTestHarness test { "A probe lost to RACK lowers the ceiling without a congestion response", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( SetMSS { TCPConfig::DEFAULT_MSS } );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 3230, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1230 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1231 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2231 ) );
+      test.execute( Tick { 50 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 25 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectCongestionWindow { 10000 } );
+      test.execute( AckReceived { Wrap32 { isn + 3231 } }.with_win( 10000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+
+      // the next probe searches below the size that was lost
+      test.execute( Push { string( 2000, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1115 ).with_seqno( isn + 3231 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 885 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
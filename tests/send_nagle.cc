@@ -0,0 +1,113 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = false;
+
+      TCPSenderTestHarness test { "Nagle holds small segments while a small one is unacknowledged", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "a" } );
+      test.execute( ExpectMessage {}.with_data( "a" ).with_seqno( isn + 1 ) );
+      test.execute( Push { "b" } );
+      test.execute( Push { "c" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 1 } );
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "bc" ).with_seqno( isn + 2 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = false;
+
+      TCPSenderTestHarness test { "Nagle never holds full-sized segments or a FIN", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push { string( 2500, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 500 ) );
+      test.execute( Push { string( 1200, 'y' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Push { "z" }.with_close() );
+      test.execute( ExpectMessage {}.with_payload_size( 201 ).with_fin( true ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = false;
+      cfg.nagle = false;
+      cfg.autocork = true;
+
+      TCPSenderTestHarness test { "Autocork holds small segments while anything is in flight", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Push { string( 1000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 1001 } }.with_win( 5000 ) );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.gso = false;
+
+      TCPSenderTestHarness test { "Corked data waits for uncork or the cork timeout", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 5000 ) );
+      test.execute( Cork { true } );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { cfg.cork_timeout_ms - 1U } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "abc" ) );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 5000 ) );
+      test.execute( Push { "def" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Cork { false } );
+      test.execute( ExpectMessage {}.with_data( "def" ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
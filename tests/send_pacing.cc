@@ -0,0 +1,105 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = true;
+      cfg.adaptive_rto = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+      cfg.pacing_rate_cap = 1'000'000; // 1000 bytes per ms
+
+      TCPSenderTestHarness test { "Pacing at a configured rate releases one segment per ms", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 1001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextTransmission { 1 } );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 2001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 3001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 5 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ).with_seqno( isn + 4001 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextTransmission { 993 } ); // only the retransmission timer is left
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = true;
+      cfg.adaptive_rto = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Pacing rate follows window / RTT", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 3000 ) );
+      test.execute( ExpectNextTransmission { std::nullopt } );
+      // 3000 bytes per 100 ms RTT, plus 25% headroom: 37.5 bytes per ms
+      test.execute( Push { string( 3000, 'x' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextTransmission { 27 } );
+      test.execute( Tick { 26 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+      cfg.pacing = false;
+      cfg.pacing_rate_cap = 1'000'000;
+
+      TCPSenderTestHarness test { "Without pacing the whole window goes out at once", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 10000 ) );
+      test.execute( Push { string( 5000, 'x' ) } );
+      for ( int i = 0; i < 5; i++ ) {
+        test.execute( ExpectMessage {}.with_payload_size( 1000 ) );
+      }
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
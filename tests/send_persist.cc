@@ -0,0 +1,117 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Zero window is probed with backoff, not with data", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( Push { "hello" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNextTransmission { cfg.rt_timeout } );
+      test.execute( Tick { cfg.rt_timeout - 1U } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextTransmission { 2UL * cfg.rt_timeout } );
+      test.execute( Tick { 2UL * cfg.rt_timeout - 1U } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 4UL * cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectConsecutiveRetransmissions { 0 } );
+
+      // A window update is acted on at once
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( ExpectMessage {}.with_data( "hello" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextTransmission { cfg.rt_timeout } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+      cfg.rt_timeout = 1000;
+
+      TCPSenderTestHarness test { "Persist backoff is bounded", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( Push { "x" } );
+      for ( const uint64_t interval : { 1000, 2000, 4000, 8000, 16000, 32000, 60000, 60000 } ) {
+        test.execute( ExpectNextTransmission { interval } );
+        test.execute( Tick { interval } );
+        test.execute( ExpectMessage {}.with_payload_size( 0 ).with_seqno( isn ) );
+        test.execute( ExpectNoSegment {} );
+      }
+      test.execute( ExpectNextTransmission { 60000 } );
+
+      // After the window closes again, probing starts over from the RTO
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1 ) );
+      test.execute( ExpectMessage {}.with_data( "x" ) );
+      test.execute( AckReceived { Wrap32 { isn + 2 } }.with_win( 0 ) );
+      test.execute( Push { "y" } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectNextTransmission { 1000 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.pacing = false;
+      cfg.gso = false;
+      cfg.rack_tlp = false;
+      cfg.persist_timer = false;
+
+      TCPSenderTestHarness test { "Without the persist timer, a byte of data probes the window", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_syn( true ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 0 ) );
+      test.execute( Push { "hello" } );
+      test.execute( ExpectMessage {}.with_data( "h" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_data( "h" ).with_seqno( isn + 1 ) );
+      test.execute( Tick { cfg.rt_timeout } );
+      test.execute( ExpectMessage {}.with_data( "h" ).with_seqno( isn + 1 ) );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
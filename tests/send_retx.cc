@@ -200,6 +200,72 @@ int main()
       test.execute( ExpectSeqnosInFlight { 0 } );
       test.execute( HasError { false } );
     }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "RTO follows the measured RTT once there is a sample", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( ExpectNextTransmission { cfg.rt_timeout } );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } } );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ) );
+      // SRTT = 100, RTTVAR = 50: RTO = 100 + 4 * 50
+      test.execute( ExpectNextTransmission { 300 } );
+      test.execute( Tick { 299 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ) );
+      test.execute( ExpectNextTransmission { 600 } );
+      test.execute( AckReceived { Wrap32 { isn + 4 } } );
+      test.execute( Push { "d" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "d" ) );
+      test.execute( ExpectNextTransmission { 300 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "RTO from a short RTT is at least 200 ms", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } } );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ) );
+      test.execute( ExpectNextTransmission { 200 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      cfg.isn = isn;
+      cfg.pacing = false;
+      cfg.rack_tlp = false;
+      cfg.adaptive_rto = false;
+
+      TCPSenderTestHarness test { "RTO stays at rt_timeout when adaptive RTO is off", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( Tick { 100 } );
+      test.execute( AckReceived { Wrap32 { isn + 1 } } );
+      test.execute( Push { "abc" } );
+      test.execute( ExpectMessage {}.with_no_flags().with_data( "abc" ) );
+      test.execute( ExpectNextTransmission { cfg.rt_timeout } );
+    }
   } catch ( const exception& e ) {
     cerr << e.what() << endl;
     return 1;
@@ -0,0 +1,138 @@
+#include "random.hh"
+#include "sender_test_harness.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main()
+{
+  try {
+    auto rd = get_random_engine();
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
+
+      TCPSenderTestHarness test { "Partially acknowledged segment is trimmed to its tail", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "abcdefgh" } );
+      test.execute( ExpectMessage {}.with_data( "abcdefgh" ).with_seqno( isn + 1 ) );
+      test.execute( AckReceived { Wrap32 { isn + 4 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 5 } );
+      test.execute( Tick { rto - 1 } );
+      test.execute( ExpectNoSegment {} );
+      test.execute( Tick { 1 } );
+      test.execute( ExpectMessage {}.with_data( "defgh" ).with_seqno( isn + 4 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( AckReceived { Wrap32 { isn + 9 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
+      cfg.nagle = false;
+
+      TCPSenderTestHarness test { "Small segments are collapsed on retransmission", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 1000 ) );
+      test.execute( Push { "ab" } );
+      test.execute( Push { "cd" } );
+      test.execute( Push { "ef" }.with_close() );
+      test.execute( ExpectMessage {}.with_data( "ab" ) );
+      test.execute( ExpectMessage {}.with_data( "cd" ) );
+      test.execute( ExpectMessage {}.with_data( "ef" ).with_fin( true ) );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( "abcdef" ).with_fin( true ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 7 } );
+      test.execute( AckReceived { Wrap32 { isn + 8 } }.with_win( 1000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( Tick { 4 * rto } );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
+      cfg.nagle = false;
+
+      TCPSenderTestHarness test { "Collapsed retransmission stops at the MSS", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+      test.execute( Push { string( 600, 'a' ) } );
+      test.execute( Push { string( 300, 'b' ) } );
+      test.execute( Push { string( 300, 'c' ) } );
+      test.execute( ExpectMessage {}.with_payload_size( 600 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 300 ) );
+      test.execute( ExpectMessage {}.with_payload_size( 300 ) );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( string( 600, 'a' ) + string( 300, 'b' ) ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+    }
+
+    {
+      TCPConfig cfg;
+      const Wrap32 isn( rd() );
+      const size_t rto = uniform_int_distribution<uint16_t> { 30, 10000 }( rd );
+      cfg.isn = isn;
+      cfg.adaptive_rto = false;
+      cfg.rt_timeout = rto;
+      cfg.rack_tlp = false;
+      cfg.nagle = false;
+
+      TCPSenderTestHarness test { "Many small segments collapse into one retransmission", cfg };
+      test.execute( Configure { cfg } );
+      test.execute( Push {} );
+      test.execute( ExpectMessage {}.with_no_flags().with_syn( true ).with_payload_size( 0 ).with_seqno( isn ) );
+      test.execute( AckReceived { Wrap32 { isn + 1 } }.with_win( 4000 ) );
+      for ( const string data : { "ab", "cd", "ef", "gh", "ij" } ) {
+        test.execute( Push { data } );
+        test.execute( ExpectMessage {}.with_data( data ) );
+      }
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( "abcdefghij" ).with_seqno( isn + 1 ) );
+      test.execute( ExpectNoSegment {} );
+      test.execute( ExpectSeqnosInFlight { 10 } );
+      test.execute( AckReceived { Wrap32 { isn + 5 } }.with_win( 4000 ) );
+      test.execute( ExpectSeqnosInFlight { 6 } );
+      test.execute( Tick { rto } );
+      test.execute( ExpectMessage {}.with_data( "efghij" ).with_seqno( isn + 5 ) );
+      test.execute( AckReceived { Wrap32 { isn + 11 } }.with_win( 4000 ) );
+      test.execute( ExpectSeqnosInFlight { 0 } );
+      test.execute( ExpectNoSegment {} );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
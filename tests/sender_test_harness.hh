@@ -7,6 +7,7 @@
 #include "tcp_sender.hh"
 #include "wrapping_integers.hh"
 
+#include <algorithm>
 #include <optional>
 #include <queue>
 #include <sstream>
@@ -80,6 +81,30 @@ struct ExpectConsecutiveRetransmissions : public ExpectNumber<SenderAndOutput, u
   uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.consecutive_retransmissions(); }
 };
 
+struct ExpectSpuriousTimeouts : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "spurious_timeouts"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.spurious_timeouts(); }
+};
+
+struct ExpectCongestionWindow : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "cwnd"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.cwnd(); }
+};
+
+struct ExpectNextTransmission : public ExpectNumber<SenderAndOutput, std::optional<uint64_t>>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "ms_until_next_transmission"; }
+  std::optional<uint64_t> value( SenderAndOutput& ss ) const override
+  {
+    return ss.sender.ms_until_next_transmission();
+  }
+};
+
 struct ExpectNoSegment : public Expectation<SenderAndOutput>
 {
   std::string description() const override { return "nothing to send"; }
@@ -104,6 +129,13 @@ struct HasError : public ExpectBool<SenderAndOutput>
   bool value( SenderAndOutput& ss ) const override { return ss.sender.writer().has_error(); }
 };
 
+struct ExpectAvailableCapacity : public ExpectNumber<SenderAndOutput, uint64_t>
+{
+  using ExpectNumber::ExpectNumber;
+  std::string name() const override { return "writer().available_capacity"; }
+  uint64_t value( SenderAndOutput& ss ) const override { return ss.sender.writer().available_capacity(); }
+};
+
 struct Push : public Action<SenderAndOutput>
 {
   std::string data_;
@@ -141,6 +173,46 @@ struct Push : public Action<SenderAndOutput>
   }
 };
 
+struct Configure : public Action<SenderAndOutput>
+{
+  TCPConfig cfg_;
+
+  explicit Configure( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  std::string description() const override { return "configure TCPSender policies from TCPConfig"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.configure( cfg_ ); }
+};
+
+struct Cork : public Action<SenderAndOutput>
+{
+  bool corked_;
+
+  explicit Cork( bool corked ) : corked_( corked ) {}
+  std::string description() const override
+  {
+    return std::string { corked_ ? "cork" : "uncork" } + " TCPSender, then push";
+  }
+  void execute( SenderAndOutput& ss ) const override
+  {
+    ss.sender.set_cork( corked_ );
+    ss.sender.push( ss.make_transmit() );
+  }
+};
+
+struct SetMSS : public Action<SenderAndOutput>
+{
+  uint64_t mss_;
+
+  explicit SetMSS( uint64_t mss ) : mss_( mss ) {}
+  std::string description() const override { return "set MSS to " + std::to_string( mss_ ); }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.set_mss( mss_ ); }
+};
+
+struct SetECN : public Action<SenderAndOutput>
+{
+  std::string description() const override { return "enable ECN"; }
+  void execute( SenderAndOutput& ss ) const override { ss.sender.set_ecn( true ); }
+};
+
 struct Tick : public Action<SenderAndOutput>
 {
   uint64_t ms_;
@@ -192,7 +264,8 @@ struct Receive : public Action<SenderAndOutput>
   std::string description() const override
   {
     std::ostringstream desc;
-    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size << ")";
+    desc << "receive(ack=" << to_string( msg_.ackno ) << ", win=" << msg_.window_size
+         << ( msg_.ECE ? ", ECE" : "" ) << ")";
     if ( push_ ) {
       desc << ", then push stream to TCPSender";
     }
@@ -205,6 +278,12 @@ struct Receive : public Action<SenderAndOutput>
     return *this;
   }
 
+  Receive& with_ece()
+  {
+    msg_.ECE = true;
+    return *this;
+  }
+
   void execute( SenderAndOutput& ss ) const override
   {
     ss.sender.receive( msg_ );
@@ -238,6 +317,9 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
   std::optional<Wrap32> seqno {};
   std::optional<std::string> data {};
   std::optional<size_t> payload_size {};
+  std::optional<uint16_t> gso_size {};
+  std::optional<bool> cwr {};
+  std::optional<uint8_t> ecn {};
 
   ExpectMessage& with_syn( bool syn_ )
   {
@@ -277,6 +359,24 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     return *this;
   }
 
+  ExpectMessage& with_gso_size( uint16_t gso_size_ )
+  {
+    gso_size = gso_size_;
+    return *this;
+  }
+
+  ExpectMessage& with_cwr( bool cwr_ )
+  {
+    cwr = cwr_;
+    return *this;
+  }
+
+  ExpectMessage& with_ecn( uint8_t ecn_ )
+  {
+    ecn = ecn_;
+    return *this;
+  }
+
   ExpectMessage& with_data( std::string data_ )
   {
     data = std::move( data_ );
@@ -302,12 +402,21 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( data.has_value() ) {
       o << " payload=\"" << Printer::prettify( data.value() ) << "\"";
     }
+    if ( gso_size.has_value() ) {
+      o << " gso_size=" << gso_size.value();
+    }
     if ( fin.has_value() ) {
       o << ( fin.value() ? " +FIN" : " (no FIN)" );
     }
     if ( rst.has_value() ) {
       o << ( rst.value() ? " +RST" : " (no RST)" );
     }
+    if ( cwr.has_value() ) {
+      o << ( cwr.value() ? " +CWR" : " (no CWR)" );
+    }
+    if ( ecn.has_value() ) {
+      o << " ecn=" << static_cast<int>( ecn.value() );
+    }
     return o.str();
   }
 
@@ -340,7 +449,20 @@ struct ExpectMessage : public Expectation<SenderAndOutput>
     if ( payload_size.has_value() and seg.payload.size() != payload_size.value() ) {
       throw ExpectationViolation( "payload_size", payload_size.value(), seg.payload.size() );
     }
-    if ( seg.payload.size() > TCPConfig::MAX_PAYLOAD_SIZE ) {
+    if ( gso_size.has_value() and seg.gso_size != gso_size.value() ) {
+      throw ExpectationViolation( "gso_size", gso_size.value(), seg.gso_size );
+    }
+    if ( cwr.has_value() and seg.CWR != cwr.value() ) {
+      throw ExpectationViolation( "CWR flag", cwr.value(), seg.CWR );
+    }
+    if ( ecn.has_value() and seg.ecn != ecn.value() ) {
+      throw ExpectationViolation( "ECN codepoint", int { ecn.value() }, int { seg.ecn } );
+    }
+    const size_t max_payload = seg.gso_size ? TCPConfig::GSO_MAX_SIZE
+                                            : std::max( { TCPConfig::MAX_PAYLOAD_SIZE,
+                                                          ss.sender.mss(),
+                                                          ss.sender.mtu_probe_size() } );
+    if ( seg.payload.size() > max_payload ) {
       throw ExpectationViolation( "payload has length (" + std::to_string( seg.payload.size() )
                                   + ") greater than the maximum" );
     }
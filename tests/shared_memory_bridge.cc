@@ -0,0 +1,110 @@
+#include "shared_memory_bridge.hh"
+
+#include "common.hh"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+static string random_bytes( size_t len, unsigned seed )
+{
+  default_random_engine rd { seed };
+  uniform_int_distribution<char> ud;
+  string data( len, 0 );
+  generate( data.begin(), data.end(), [&] { return ud( rd ); } );
+  return data;
+}
+
+// Write `out` in chunks of random size and close, while reading everything from the other end; sleep only
+// when neither can make progress, the way the TCP thread and the owner do
+static string exchange( SharedMemoryBridge::End& end, const string& out, unsigned seed )
+{
+  default_random_engine rd { seed };
+  uniform_int_distribution<size_t> chunk { 1, 3000 };
+  string in;
+  size_t written = 0;
+
+  const auto step = [&] {
+    bool moved = false;
+    if ( written < out.size() ) {
+      const size_t len = end.write( string_view { out }.substr( written, chunk( rd ) ) );
+      written += len;
+      moved = len > 0;
+    } else if ( not end.is_closed() ) {
+      end.close();
+      moved = true;
+    }
+    while ( end.bytes_buffered() > 0 ) {
+      const string_view data = end.peek(); // the other end may write more before pop()
+      in += data;
+      end.pop( data.size() );
+      moved = true;
+    }
+    return moved;
+  };
+
+  while ( not end.is_closed() or not end.is_finished() ) {
+    if ( not step() ) {
+      end.arm();
+      if ( not step() ) {
+        end.wait();
+      }
+    }
+  }
+  return in;
+}
+
+int main()
+{
+  try {
+    // Unused rings
+    {
+      SharedMemoryBridge bridge { 1000 };
+      expect( bridge.owner().available_capacity() == 1024, "capacity rounds up to a power of two" );
+      expect( bridge.thread().bytes_buffered() == 0 and bridge.thread().peek().empty(), "starts empty" );
+      expect( not bridge.thread().is_finished(), "not finished before the other end closes" );
+
+      expect( bridge.owner().write( string( 1500, 'x' ) ) == 1024, "write stops at a full ring" );
+      expect( bridge.owner().write( "y" ) == 0, "nothing fits in a full ring" );
+      bridge.thread().pop( 1000 );
+      expect( bridge.owner().write( "hello" ) == 5, "popping makes room" );
+      expect( bridge.thread().peek() == string( 24, 'x' ), "peek stops at the end of the buffer" );
+      bridge.thread().pop( 24 );
+      expect( bridge.thread().peek() == "hello", "bytes wrap around to the start" );
+
+      bridge.owner().close();
+      expect( not bridge.thread().is_finished(), "not finished until every byte is popped" );
+      bridge.thread().pop( 5 );
+      expect( bridge.thread().is_finished(), "finished once closed and empty" );
+    }
+
+    // Two threads streaming both ways at once through small rings, so that both fill and wrap around many
+    // times, and both ends sleep on their eventfd
+    {
+      SharedMemoryBridge bridge { 4096 };
+      const string to_thread = random_bytes( 1 << 22, 1 );
+      const string to_owner = random_bytes( 1 << 22, 2 );
+
+      string received_by_thread;
+      thread other { [&] { received_by_thread = exchange( bridge.thread(), to_owner, 3 ); } };
+      const string received_by_owner = exchange( bridge.owner(), to_thread, 4 );
+      other.join();
+
+      expect( received_by_owner == to_owner, "owner receives what the thread wrote" );
+      expect( received_by_thread == to_thread, "thread receives what the owner wrote" );
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include "tcp_async.hh"
+
+#include "common.hh"
+#include "exception.hh"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static string random_bytes( size_t len, unsigned seed )
+{
+  default_random_engine rd { seed };
+  uniform_int_distribution<char> ud;
+  string data( len, 0 );
+  generate( data.begin(), data.end(), [&] { return ud( rd ); } );
+  return data;
+}
+
+// Server: send back everything the client sends, then close
+static TCPAsyncTask echo( TCPAsyncConnection connection, size_t& served )
+{
+  string buffer;
+  while ( co_await connection.read( buffer ) > 0 ) {
+    co_await connection.write( buffer );
+    buffer.clear();
+  }
+  connection.close();
+  served++;
+}
+
+// Server: one handler per connection, all on the stack's one thread
+static TCPAsyncTask serve( TCPAsyncStack& stack, TCPAsyncListener listener, size_t connections, size_t& served )
+{
+  for ( size_t i = 0; i < connections; i++ ) {
+    stack.spawn( echo( co_await listener.accept(), served ) );
+  }
+}
+
+// Client: send a request, close, and read the echo to the end
+static TCPAsyncTask request( TCPAsyncStack& stack, uint16_t port, string data, size_t& matched )
+{
+  TCPAsyncConnection connection
+    = co_await stack.connect( Address { "10.144.0.1", port }, Address { "10.144.0.2", 80 } );
+  co_await connection.write( data );
+  connection.close();
+
+  string echoed;
+  string buffer;
+  while ( co_await connection.read( buffer ) > 0 ) {
+    echoed += buffer;
+    buffer.clear();
+  }
+  if ( echoed == data ) {
+    matched++;
+  }
+}
+
+static TCPAsyncTask connect_to_closed_port( TCPAsyncStack& stack, bool& refused )
+{
+  try {
+    co_await stack.connect( Address { "10.144.0.1", 39999 }, Address { "10.144.0.2", 81 } );
+  } catch ( const runtime_error& ) {
+    refused = true;
+  }
+}
+
+static TCPAsyncTask fail()
+{
+  throw runtime_error( "a coroutine failed" );
+  co_return;
+}
+
+int main()
+{
+  try {
+    // A stack that is never run frees its coroutines' frames
+    {
+      array<int, 2> fds {};
+      CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_SEQPACKET, 0, fds.data() ) );
+      FileDescriptor other { fds[1] };
+      TCPAsyncStack stack { FileDescriptor { fds[0] }, TCPConfig {} };
+      bool refused = false;
+      stack.spawn( connect_to_closed_port( stack, refused ) );
+      expect( not refused, "the connect() is still waiting" );
+    }
+
+    // An exception that escapes a coroutine comes out of run()
+    {
+      array<int, 2> fds {};
+      CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_SEQPACKET, 0, fds.data() ) );
+      FileDescriptor other { fds[1] };
+      TCPAsyncStack stack { FileDescriptor { fds[0] }, TCPConfig {} };
+      stack.spawn( fail() );
+      bool thrown = false;
+      try {
+        stack.run();
+      } catch ( const runtime_error& e ) {
+        thrown = string { e.what() } == "a coroutine failed";
+      }
+      expect( thrown, "run() rethrows the coroutine's exception" );
+    }
+
+    // Many clients on one thread, served by one handler each on another thread, over a datagram socket pair
+    constexpr size_t flows = 64;
+    array<int, 2> fds {};
+    CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_SEQPACKET, 0, fds.data() ) );
+    TCPConfig cfg;
+    cfg.rt_timeout = 50; // the client lingers for ten of these after the echo ends
+    TCPAsyncStack server_stack { FileDescriptor { fds[1] }, cfg };
+    TCPAsyncStack client_stack { FileDescriptor { fds[0] }, cfg };
+
+    size_t served = 0;
+    server_stack.spawn( serve( server_stack, server_stack.listen( 80 ), flows, served ) );
+    exception_ptr server_error;
+    thread server { [&] {
+      try {
+        server_stack.run();
+      } catch ( ... ) {
+        server_error = current_exception();
+      }
+    } };
+
+    size_t matched = 0;
+    bool refused = false;
+    default_random_engine rd { 144 };
+    uniform_int_distribution<size_t> size { 1, 100000 };
+    for ( size_t i = 0; i < flows; i++ ) {
+      const auto port = static_cast<uint16_t>( 40000 + i );
+      client_stack.spawn( request( client_stack, port, random_bytes( size( rd ), port ), matched ) );
+    }
+    client_stack.spawn( connect_to_closed_port( client_stack, refused ) );
+    client_stack.run();
+    server.join();
+    if ( server_error ) {
+      rethrow_exception( server_error );
+    }
+
+    expect( matched == flows,
+            "every client got its echo (" + to_string( matched ) + " of " + to_string( flows ) + ")" );
+    expect( served == flows, "every connection was served" );
+    expect( refused, "a connect() to a port nobody listens on fails" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+#include "common.hh"
+#include "tcp_connection_manager.hh"
+#include "tcp_over_ip.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Deliver everything each side has sent to the other, letting time pass until both go quiet
+static void exchange( TCPConnectionManager& a, TCPConnectionManager& b )
+{
+  for ( unsigned quiet = 0; quiet < 50; ) {
+    bool moved = false;
+    for ( auto [from, to] : { pair { &a, &b }, pair { &b, &a } } ) {
+      while ( not from->datagrams_out().empty() ) {
+        to->receive( from->datagrams_out().front() );
+        from->datagrams_out().pop();
+        moved = true;
+      }
+    }
+    quiet = moved ? 0 : quiet + 1;
+    a.tick( 10 );
+    b.tick( 10 );
+  }
+}
+
+static string read_all( TCPPeer& peer )
+{
+  string data;
+  while ( peer.inbound_reader().bytes_buffered() > 0 ) {
+    data += peer.inbound_reader().peek();
+    peer.inbound_reader().pop( peer.inbound_reader().peek().size() );
+  }
+  return data;
+}
+
+int main()
+{
+  try {
+    constexpr size_t flows = 1000;
+    const TCPConfig cfg;
+    TCPConnectionManager client { cfg };
+    TCPConnectionManager server { cfg };
+    server.listen( 80, flows, flows );
+
+    // Many connections between the same two hosts, told apart only by the client's port
+    vector<FourTuple> ids;
+    for ( size_t i = 0; i < flows; i++ ) {
+      ids.push_back( client.connect( Address { "10.0.0.1", static_cast<uint16_t>( 10000 + i ) },
+                                     Address { "10.0.0.2", 80 } ) );
+    }
+    exchange( client, server );
+    expect( server.accepted( 80 ).size() == flows and server.size() == flows, "every SYN opens a connection" );
+
+    for ( size_t i = 0; i < flows; i++ ) {
+      client.find( ids[i] )->outbound_writer().push( "request " + to_string( i ) );
+      client.push( ids[i] );
+    }
+    exchange( client, server );
+
+    // Each request reaches its own connection, and each reply goes back to the right client
+    while ( not server.accepted( 80 ).empty() ) {
+      const FourTuple id = server.accepted( 80 ).front();
+      server.accepted( 80 ).pop();
+      TCPPeer* peer = server.find( id );
+      expect( peer != nullptr, "accepted connection is open" );
+      const string request = read_all( *peer );
+      expect( request == "request " + to_string( id.remote_port - 10000 ), "request demultiplexed by 4-tuple" );
+      peer->outbound_writer().push( "reply to " + request );
+      peer->outbound_writer().close();
+      server.push( id );
+    }
+    exchange( client, server );
+
+    for ( size_t i = 0; i < flows; i++ ) {
+      TCPPeer* peer = client.find( ids[i] );
+      expect( read_all( *peer ) == "reply to request " + to_string( i ), "reply demultiplexed by 4-tuple" );
+      expect( peer->inbound_reader().is_finished(), "server closed its side" );
+      peer->outbound_writer().close();
+      client.push( ids[i] );
+    }
+    for ( unsigned i = 0; i < 25; i++ ) { // past the server's linger time (10 RTOs)
+      exchange( client, server );
+    }
+    expect( client.size() == 0 and server.size() == 0, "finished connections are dropped" );
+
+    // A segment for no connection is answered with a RST
+    TCPMessage stray { .sender = { .seqno = Wrap32 { 5 }, .payload = "hello" } };
+    server.receive( TCPOverIPv4Adapter::make_tcp_in_ip(
+      stray, Address { "10.0.0.1", 0 }.ipv4_numeric(), 4444, Address { "10.0.0.2", 0 }.ipv4_numeric(), 80 ) );
+    expect( server.datagrams_out().size() == 1, "stray segment is answered" );
+    const auto rst = TCPOverIPv4Adapter::parse_tcp_in_ip( server.datagrams_out().front() );
+    expect( rst.has_value() and rst->message.sender.RST and rst->message.receiver.ackno == Wrap32 { 10 }
+              and rst->udinfo.dst_port == 4444,
+            "RST acknowledges the stray segment" );
+    expect( server.size() == 0, "no connection without a SYN" );
+    server.datagrams_out().pop();
+
+    // The SYN queue and the accept queue are bounded
+    server.listen( 8080, 2, 1 );
+    for ( uint16_t port = 20000; port < 20003; port++ ) {
+      client.connect( Address { "10.0.0.1", port }, Address { "10.0.0.2", 8080 } );
+      server.receive( client.datagrams_out().front() );
+      client.datagrams_out().pop();
+    }
+    expect( server.half_open( 8080 ) == 2 and server.datagrams_out().size() == 2, "SYN beyond backlog dropped" );
+    exchange( client, server );
+    expect( server.accepted( 8080 ).size() == 1 and server.half_open( 8080 ) == 2, "accept queue holds one" );
+    server.accepted( 8080 ).pop();
+    server.tick( 0 );
+    expect( server.accepted( 8080 ).size() == 1 and server.half_open( 8080 ) == 1, "room in the accept queue" );
+
+    // Only connections with work due are ticked; the others catch up on the time when their deadline comes
+    const uint64_t rto = cfg.rt_timeout;
+    TCPConnectionManager timed { cfg };
+    const FourTuple early = timed.connect( Address { "10.0.1.1", 1000 }, Address { "10.0.1.2", 80 } );
+    timed.tick( 400 );
+    const FourTuple late = timed.connect( Address { "10.0.1.1", 1001 }, Address { "10.0.1.2", 80 } );
+    expect( timed.datagrams_out().size() == 2, "two SYNs" );
+    timed.datagrams_out() = {};
+    expect( timed.ms_until_next_tick() == rto - 400, "the first SYN's timer is due first" );
+    timed.tick( rto - 400 );
+    expect( timed.datagrams_out().size() == 1 and timed.find( early )->sender().consecutive_retransmissions() == 1
+              and timed.find( late )->sender().consecutive_retransmissions() == 0,
+            "only the first SYN is sent again" );
+    expect( timed.ms_until_next_tick() == 400, "then the second SYN's" );
+    timed.tick( 400 );
+    expect( timed.datagrams_out().size() == 2 and timed.find( late )->sender().consecutive_retransmissions() == 1,
+            "the second SYN is sent again" );
+    expect( timed.ms_until_next_tick() == 2 * rto - 400, "the first SYN's backed-off timer is next" );
+
+    // Each call reports the connections it acted on, and only those
+    vector<FourTuple> active;
+    timed.on_activity( [&]( const FourTuple& id ) { active.push_back( id ); } );
+    timed.tick( 2 * rto - 400 );
+    expect( active == vector { early }, "a tick reports the connection whose timer was due" );
+    active.clear();
+    timed.push( late );
+    expect( active == vector { late }, "push() reports its connection" );
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,252 @@
+#include "exception.hh"
+#include "parser.hh"
+#include "tcp_minnow_socket_impl.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Carries each IPv4 datagram as one message on an AF_UNIX SOCK_SEQPACKET socket, in place of a TUN device,
+// so that two TCPMinnowSockets in one process can talk to each other
+class TCPOverIPv4OverSeqpacketAdapter : public TCPOverIPv4Adapter
+{
+  FileDescriptor _fd;
+
+public:
+  explicit TCPOverIPv4OverSeqpacketAdapter( FileDescriptor&& fd ) : _fd( std::move( fd ) )
+  {
+    _fd.set_blocking( false );
+  }
+
+  optional<TCPMessage> read()
+  {
+    string buffer;
+    _fd.read( buffer );
+    InternetDatagram ip_dgram;
+    if ( buffer.empty() or not parse( ip_dgram, vector<string> { std::move( buffer ) } ) ) {
+      return {};
+    }
+    return unwrap_tcp_in_ip( ip_dgram );
+  }
+
+  vector<TCPMessage> read_all()
+  {
+    vector<TCPMessage> msgs;
+    for ( size_t i = 0; i < TCPOverIPv4OverTunFdAdapter::GRO_MAX_BURST; i++ ) {
+      string buffer;
+      _fd.read( buffer );
+      if ( buffer.empty() ) {
+        break;
+      }
+      InternetDatagram ip_dgram;
+      if ( parse( ip_dgram, vector<string> { std::move( buffer ) } ) ) {
+        if ( auto msg = unwrap_tcp_in_ip( ip_dgram ) ) {
+          msgs.push_back( std::move( msg.value() ) );
+        }
+      }
+    }
+    return msgs;
+  }
+
+  void write( const TCPMessage& seg )
+  {
+    for ( const auto& piece : split_gso( seg ) ) {
+      _fd.write( serialize( wrap_tcp_in_ip( piece ) ) );
+    }
+  }
+
+  FileDescriptor& fd() { return _fd; }
+};
+
+using PingPongSocket = TCPMinnowSocket<TCPOverIPv4OverSeqpacketAdapter>;
+
+struct Mode
+{
+  string name;
+  optional<BusyPollConfig> busy_poll;
+  bool shared_memory;
+};
+
+static constexpr size_t MESSAGE_SIZE = 64;
+
+// The owner's side of a round: spins (up to the same budget as the TCP thread) when busy polling
+static void send_message( PingPongSocket& sock, const Mode& mode, string_view data )
+{
+  while ( not data.empty() ) {
+    data.remove_prefix( mode.shared_memory ? sock.shared_memory().write( data ) : sock.write( data ) );
+  }
+}
+
+static void receive_message( PingPongSocket& sock, const Mode& mode )
+{
+  const uint64_t spin_us = mode.busy_poll.has_value() ? mode.busy_poll->spin_us : 0;
+  size_t received = 0;
+  auto spin_end = steady_clock::now() + microseconds( spin_us );
+  while ( received < MESSAGE_SIZE ) {
+    size_t len = 0;
+    if ( mode.shared_memory ) {
+      SharedMemoryBridge::End& bridge = sock.shared_memory();
+      len = min<uint64_t>( bridge.bytes_buffered(), MESSAGE_SIZE - received );
+      bridge.pop( len );
+      if ( len == 0 and bridge.is_finished() ) {
+        throw runtime_error( "connection closed during the ping-pong" );
+      }
+    } else {
+      string buffer( MESSAGE_SIZE - received, 0 );
+      sock.read( buffer );
+      len = buffer.size();
+      if ( sock.eof() ) {
+        throw runtime_error( "connection closed during the ping-pong" );
+      }
+    }
+    received += len;
+
+    if ( len > 0 or steady_clock::now() < spin_end ) {
+      continue;
+    }
+    if ( mode.shared_memory ) {
+      sock.shared_memory().arm();
+      if ( sock.shared_memory().bytes_buffered() == 0 and not sock.shared_memory().is_finished() ) {
+        sock.shared_memory().wait();
+      }
+    } else {
+      pollfd readable { sock.fd_num(), POLLIN, 0 };
+      CheckSystemCall( "poll", ::poll( &readable, 1, -1 ) );
+    }
+    spin_end = steady_clock::now() + microseconds( spin_us );
+  }
+}
+
+static void set_up( PingPongSocket& sock, const Mode& mode, optional<int> cpu )
+{
+  if ( mode.busy_poll.has_value() ) {
+    BusyPollConfig config = mode.busy_poll.value();
+    config.cpu = cpu;
+    sock.set_busy_poll( config );
+  }
+  if ( mode.shared_memory ) {
+    sock.use_shared_memory();
+  }
+}
+
+// Round-trip times of `rounds` small request/response exchanges between two TCPMinnowSockets, in microseconds
+static vector<double> ping_pong( const Mode& mode, size_t rounds )
+{
+  array<int, 2> fds {};
+  CheckSystemCall( "socketpair", ::socketpair( AF_UNIX, SOCK_SEQPACKET, 0, fds.data() ) );
+  FileDescriptor client_wire { fds[0] };
+  FileDescriptor server_wire { fds[1] };
+
+  TCPConfig tcp_config;
+  tcp_config.rt_timeout = 20; // keep the linger after the close short
+
+  FdAdapterConfig server_config;
+  server_config.source = { "10.144.0.2", "7" };
+  FdAdapterConfig client_config;
+  client_config.source = { "10.144.0.1", "40000" };
+  client_config.destination = server_config.source;
+
+  // with enough cores, give each TCP thread a core of its own, apart from the owners'
+  const bool pin = thread::hardware_concurrency() >= 4;
+
+  thread server { [&] {
+    PingPongSocket sock { TCPOverIPv4OverSeqpacketAdapter { std::move( server_wire ) } };
+    set_up( sock, mode, pin ? optional<int> { 2 } : nullopt );
+    sock.listen_and_accept( tcp_config, server_config );
+    const string message( MESSAGE_SIZE, 'y' );
+    for ( size_t i = 0; i < rounds; i++ ) {
+      receive_message( sock, mode );
+      send_message( sock, mode, message );
+    }
+    sock.wait_until_closed();
+  } };
+
+  vector<double> rtts;
+  rtts.reserve( rounds );
+  {
+    PingPongSocket sock { TCPOverIPv4OverSeqpacketAdapter { std::move( client_wire ) } };
+    set_up( sock, mode, pin ? optional<int> { 3 } : nullopt );
+    sock.connect( tcp_config, client_config );
+    const string message( MESSAGE_SIZE, 'x' );
+    for ( size_t i = 0; i < rounds; i++ ) {
+      const auto start = steady_clock::now();
+      send_message( sock, mode, message );
+      receive_message( sock, mode );
+      rtts.push_back( duration_cast<duration<double, micro>>( steady_clock::now() - start ).count() );
+    }
+    sock.wait_until_closed();
+
+    const TCPInfo info = sock.info();
+    if ( info.bytes_acked != rounds * MESSAGE_SIZE or info.bytes_received != rounds * MESSAGE_SIZE ) {
+      throw runtime_error( "TCPMinnowSocket ping-pong (" + mode.name + ") counted " + info.to_string() );
+    }
+  }
+  server.join();
+
+  return rtts;
+}
+
+static double percentile( const vector<double>& sorted, double p )
+{
+  const auto rank = static_cast<size_t>( p / 100 * static_cast<double>( sorted.size() ) );
+  return sorted.at( min( sorted.size() - 1, rank ) );
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  const vector<Mode> modes {
+    { "sleeping", nullopt, false },
+    { "busy poll", BusyPollConfig { 50, nullopt }, false },
+    { "busy poll + shared memory", BusyPollConfig { 50, nullopt }, true },
+  };
+
+  for ( const auto& mode : modes ) {
+    vector<double> rtts = ping_pong( mode, 2000 );
+    sort( rtts.begin(), rtts.end() );
+
+    // busy polling pays off only with a core for each spinning thread; on fewer cores, the spinners steal time
+    cout << "TCPMinnowSocket ping-pong (" << mode.name << ", " << MESSAGE_SIZE << "-byte messages, "
+         << thread::hardware_concurrency() << " cores) round trip: " << fixed << setprecision( 1 ) << "p50 "
+         << percentile( rtts, 50 ) << " us, p90 " << percentile( rtts, 90 ) << " us, p99 " << percentile( rtts, 99 )
+         << " us, p99.9 " << percentile( rtts, 99.9 ) << " us, max " << rtts.back() << " us.\n";
+
+    debug_output << "   TCPMinnowSocket ping-pong p50/p99 (" << mode.name << "): " << fixed << setprecision( 1 )
+                 << percentile( rtts, 50 ) << " / " << percentile( rtts, 99 ) << " us\n";
+
+    if ( percentile( rtts, 50 ) > 100000 ) {
+      throw runtime_error( "TCPMinnowSocket ping-pong (" + mode.name + ") median round trip exceeded 100 ms." );
+    }
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
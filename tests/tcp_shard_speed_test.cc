@@ -0,0 +1,133 @@
+#include "tcp_sharded_stack.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// Bytes one shard has delivered, on a cache line of its own
+struct alignas( 64 ) ShardCounter
+{
+  atomic<uint64_t> bytes = 0;
+};
+
+// Aggregate goodput of bulk transfers spread over `shards` shards. Each shard carries its own connections
+// over a loopback (what a shard sends, it receives), so the shards share nothing at all, and the rate should
+// grow with the number of shards up to the number of cores.
+static double sharded_throughput( size_t shards, size_t flows_per_shard, milliseconds measure )
+{
+  const string chunk( 65536, 'x' );
+  vector<ShardCounter> counters( shards );
+  vector<vector<FourTuple>> clients( shards );
+  vector<vector<FourTuple>> servers( shards );
+
+  TCPShardedStack stack {
+    shards,
+    TCPConfig {},
+    []( TCPShardedStack::Shard& shard, InternetDatagram&& dgram ) { shard.manager().receive( dgram ); },
+    [&]( TCPShardedStack::Shard& shard ) {
+      TCPConnectionManager& manager = shard.manager();
+      auto& my_clients = clients.at( shard.index() );
+      auto& my_servers = servers.at( shard.index() );
+
+      if ( my_clients.empty() ) {
+        for ( size_t i = 0; i < flows_per_shard; i++ ) {
+          my_clients.push_back( shard.connect( "10.0.0.1", Address { "10.0.0.2", 80 } ) );
+        }
+      }
+      for ( const auto& id : my_clients ) {
+        Writer& writer = manager.find( id )->outbound_writer();
+        const uint64_t room = writer.available_capacity();
+        if ( room > 0 ) {
+          writer.push( chunk.substr( 0, min<uint64_t>( room, chunk.size() ) ) );
+          manager.push( id );
+        }
+      }
+
+      while ( not manager.accepted( 80 ).empty() ) {
+        my_servers.push_back( manager.accepted( 80 ).front() );
+        manager.accepted( 80 ).pop();
+      }
+      uint64_t bytes = 0;
+      for ( const auto& id : my_servers ) {
+        Reader& reader = manager.find( id )->inbound_reader();
+        while ( reader.bytes_buffered() > 0 ) {
+          bytes += reader.peek().size();
+          reader.pop( reader.peek().size() );
+        }
+        manager.update_window( id );
+      }
+      counters.at( shard.index() ).bytes.fetch_add( bytes, memory_order_relaxed );
+    } };
+  stack.listen( 80 );
+  stack.start();
+
+  const auto total = [&] {
+    uint64_t sum = 0;
+    for ( const auto& counter : counters ) {
+      sum += counter.bytes.load( memory_order_relaxed );
+    }
+    return sum;
+  };
+
+  // let the connections open and the windows grow before measuring
+  this_thread::sleep_for( measure / 4 );
+  const auto start_bytes = total();
+  const auto start_time = steady_clock::now();
+  this_thread::sleep_for( measure );
+  const auto stop_bytes = total();
+  const auto stop_time = steady_clock::now();
+
+  const auto test_duration = duration_cast<duration<double>>( stop_time - start_time );
+  return 8 * static_cast<double>( stop_bytes - start_bytes ) / test_duration.count() / 1e9;
+}
+
+void program_body()
+{
+  fstream debug_output;
+  debug_output.open( "/dev/tty" );
+
+  const size_t max_shards = clamp<size_t>( thread::hardware_concurrency(), 2, 8 );
+  double one_shard = 0;
+  for ( size_t shards = 1; shards <= max_shards; shards *= 2 ) {
+    const double gigabits_per_second = sharded_throughput( shards, 4, milliseconds( 300 ) );
+    if ( shards == 1 ) {
+      one_shard = gigabits_per_second;
+    }
+
+    cout << "TCPShardedStack with shards=" << shards << " (of " << thread::hardware_concurrency()
+         << " cores) reached " << fixed << setprecision( 2 ) << gigabits_per_second << " Gbit/s, "
+         << gigabits_per_second / one_shard << "x one shard.\n";
+
+    debug_output << "   TCPShardedStack throughput (" << shards << " shards): " << fixed << setprecision( 2 )
+                 << gigabits_per_second << " Gbit/s\n";
+  }
+
+  if ( one_shard < 0.01 ) {
+    throw runtime_error( "TCPShardedStack did not meet minimum speed of 0.01 Gbit/s." );
+  }
+}
+
+int main()
+{
+  try {
+    program_body();
+  } catch ( const exception& e ) {
+    cerr << "Exception: " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include "common.hh"
+#include "tcp_sharded_stack.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+// What one shard did; touched only by the shard's thread until the stack is destroyed
+struct ShardLog
+{
+  vector<FourTuple> clients {};
+  unordered_map<FourTuple, string, FourTupleHash> requests {};
+  vector<string> served {};
+};
+
+int main()
+{
+  try {
+    constexpr size_t shards = 4;
+    constexpr size_t flows_per_shard = 16;
+    constexpr size_t flows = shards * flows_per_shard;
+
+    // Both ends of every connection live in the same stack, connected by a wire that loops each datagram the
+    // shards send back to deliver(), from this one thread, to be steered by its 4-tuple. The two ends of a
+    // connection generally hash to different shards.
+    mutex wire_mutex;
+    queue<InternetDatagram> wire;
+    vector<ShardLog> logs( shards );
+    atomic<size_t> served = 0;
+
+    {
+      TCPShardedStack stack {
+        shards,
+        TCPConfig {},
+        [&]( TCPShardedStack::Shard&, InternetDatagram&& dgram ) {
+          const lock_guard lock( wire_mutex );
+          wire.push( std::move( dgram ) );
+        },
+        [&]( TCPShardedStack::Shard& shard ) {
+          ShardLog& log = logs.at( shard.index() );
+          TCPConnectionManager& manager = shard.manager();
+
+          // client: each shard opens its own connections, and sends one request on each
+          if ( log.clients.empty() ) {
+            for ( size_t i = 0; i < flows_per_shard; i++ ) {
+              const FourTuple id = shard.connect( "10.0.0.1", Address { "10.0.0.2", 80 } );
+              manager.find( id )->outbound_writer().push( "request " + to_string( id.local_port ) );
+              manager.find( id )->outbound_writer().close();
+              manager.push( id );
+              log.clients.push_back( id );
+            }
+          }
+
+          // server: read each request to the end, then close
+          while ( not manager.accepted( 80 ).empty() ) {
+            log.requests.emplace( manager.accepted( 80 ).front(), "" );
+            manager.accepted( 80 ).pop();
+          }
+          for ( auto it = log.requests.begin(); it != log.requests.end(); ) {
+            TCPPeer* peer = manager.find( it->first );
+            if ( peer == nullptr ) {
+              it = log.requests.erase( it );
+              continue;
+            }
+            Reader& reader = peer->inbound_reader();
+            while ( reader.bytes_buffered() > 0 ) {
+              it->second += reader.peek();
+              reader.pop( reader.peek().size() );
+            }
+            manager.update_window( it->first );
+            if ( not reader.is_finished() ) {
+              ++it;
+              continue;
+            }
+            log.served.push_back( it->second );
+            served++;
+            peer->outbound_writer().close();
+            manager.push( it->first );
+            it = log.requests.erase( it );
+          }
+        } };
+      stack.listen( 80, flows, flows );
+      stack.start();
+
+      const auto deadline = steady_clock::now() + seconds( 5 );
+      while ( served < flows and steady_clock::now() < deadline ) {
+        queue<InternetDatagram> in_flight;
+        {
+          const lock_guard lock( wire_mutex );
+          swap( in_flight, wire );
+        }
+        if ( in_flight.empty() ) {
+          this_thread::sleep_for( milliseconds( 1 ) );
+        }
+        for ( ; not in_flight.empty(); in_flight.pop() ) {
+          stack.deliver( std::move( in_flight.front() ) );
+        }
+      }
+    }
+
+    // Every connection a shard opened hashes back to that shard
+    for ( size_t i = 0; i < shards; i++ ) {
+      expect( logs.at( i ).clients.size() == flows_per_shard, "every shard opens its connections" );
+      for ( const auto& id : logs.at( i ).clients ) {
+        expect( FourTupleHash {}( id ) % shards == i, "connect() picks a port that hashes to its own shard" );
+      }
+    }
+
+    // Every request reached its server, and the servers were spread over the shards
+    set<string> requests;
+    for ( const auto& log : logs ) {
+      expect( not log.served.empty(), "every shard serves some connections" );
+      requests.insert( log.served.begin(), log.served.end() );
+    }
+    expect( served == flows and requests.size() == flows, "every request is served exactly once" );
+    for ( const auto& log : logs ) {
+      for ( const auto& id : log.clients ) {
+        expect( requests.contains( "request " + to_string( id.local_port ) ), "request reaches its server" );
+      }
+    }
+  } catch ( const exception& e ) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+
+  return EXIT_SUCCESS;
+}
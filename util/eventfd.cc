@@ -0,0 +1,24 @@
+#include "eventfd.hh"
+#include "exception.hh"
+
+#include <cstdint>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace std;
+
+EventFD::EventFD() : FileDescriptor( ::CheckSystemCall( "eventfd", eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) ) {}
+
+void EventFD::notify()
+{
+  // a raw write(), which leaves alone the counts that the polling thread's EventLoop keeps
+  const uint64_t one = 1;
+  CheckSystemCall( "write", ::write( fd_num(), &one, sizeof( one ) ) );
+}
+
+void EventFD::clear()
+{
+  string counter;
+  read( counter );
+}
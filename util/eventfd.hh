@@ -0,0 +1,18 @@
+#pragma once
+
+#include "file_descriptor.hh"
+
+//! A FileDescriptor to a Linux [eventfd](\ref man2::eventfd): a counter that one thread bumps to wake another
+//! that is polling it
+class EventFD : public FileDescriptor
+{
+public:
+  //! Create a non-blocking eventfd
+  EventFD();
+
+  //! Make the eventfd readable (from any thread)
+  void notify();
+
+  //! Reset the counter, once woken (this reads the eventfd, so it services an EventLoop rule)
+  void clear();
+};
@@ -180,7 +180,8 @@ size_t FileDescriptor::write( const vector<string_view>& buffers )
     = CheckSystemCall( "writev", ::writev( fd_num(), iovecs.data(), static_cast<int>( iovecs.size() ) ) );
   register_write();
 
-  if ( bytes_written == 0 and total_size != 0 ) {
+  // (a non-blocking fd that would block writes nothing, as a read from it reads nothing)
+  if ( bytes_written == 0 and total_size != 0 and not internal_fd_->non_blocking_ ) {
     throw runtime_error( "write returned 0 given non-empty input buffer" );
   }
 
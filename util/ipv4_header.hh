@@ -13,6 +13,12 @@ struct IPv4Header
   static constexpr uint8_t DEFAULT_TTL = 128; // A reasonable default TTL value
   static constexpr uint8_t PROTO_TCP = 6;     // Protocol number for TCP
 
+  // ECN codepoints (RFC 3168), carried in the low two bits of the type-of-service byte
+  static constexpr uint8_t ECN_MASK = 0b11;
+  static constexpr uint8_t ECN_ECT1 = 0b01; // ECN-capable transport
+  static constexpr uint8_t ECN_ECT0 = 0b10; // ECN-capable transport
+  static constexpr uint8_t ECN_CE = 0b11;   // congestion experienced: a router marked it instead of dropping it
+
   static constexpr uint64_t serialized_length() { return LENGTH; }
 
   /*
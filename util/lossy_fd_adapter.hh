@@ -8,6 +8,7 @@
 #include <optional>
 #include <random>
 #include <utility>
+#include <vector>
 
 //! An adapter class that adds random dropping behavior to an FD adapter
 template<typename AdapterT>
@@ -49,10 +50,30 @@ public:
     return ret;
   }
 
+  //! \brief Read a burst from the underlying AdapterT instance, dropping each datagram independently,
+  //!        then merge what is left (see coalesce_gro)
+  std::vector<TCPMessage> read_all()
+  {
+    std::vector<TCPMessage> kept;
+    for ( auto& msg : _adapter.read_burst() ) {
+      if ( not _should_drop( false ) ) {
+        kept.push_back( std::move( msg ) );
+      }
+    }
+    return coalesce_gro( std::move( kept ) );
+  }
+
   //! \brief Write to the underlying AdapterT instance, potentially dropping the datagram to be written
   //! \param[in] seg is the packet to either write or drop
   void write( const TCPMessage& seg )
   {
+    // each wire segment of a GSO super-segment is dropped (or not) on its own
+    if ( seg.sender.gso_size != 0 ) {
+      for ( const auto& piece : split_gso( seg ) ) {
+        write( piece );
+      }
+      return;
+    }
     if ( _should_drop( true ) ) {
       return;
     }
@@ -0,0 +1,102 @@
+#include "shared_memory_bridge.hh"
+
+#include "exception.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <poll.h>
+
+using namespace std;
+
+SharedMemoryBridge::Ring::Ring( size_t capacity ) : buffer( bit_ceil( max<size_t>( capacity, 1 ) ) ) {}
+
+SharedMemoryBridge::End::End( Ring& tx, Ring& rx ) : tx_( tx ), rx_( rx ) {}
+
+SharedMemoryBridge::SharedMemoryBridge( size_t capacity ) : to_thread_( capacity ), to_owner_( capacity )
+{
+  owner_.peer_ = &thread_;
+  thread_.peer_ = &owner_;
+}
+
+size_t SharedMemoryBridge::End::write( string_view data )
+{
+  const uint64_t tail = tx_.tail.load( memory_order_relaxed );
+  const uint64_t len = min<uint64_t>( data.size(), available_capacity() );
+  if ( len == 0 ) {
+    return 0;
+  }
+
+  // the free space may wrap around the end of the buffer
+  const uint64_t mask = tx_.buffer.size() - 1;
+  const uint64_t first = min( len, tx_.buffer.size() - ( tail & mask ) );
+  memcpy( tx_.buffer.data() + ( tail & mask ), data.data(), first );
+  memcpy( tx_.buffer.data(), data.data() + first, len - first );
+  tx_.tail.store( tail + len, memory_order_release );
+
+  wake_peer();
+  return len;
+}
+
+void SharedMemoryBridge::End::close()
+{
+  tx_.closed.store( true, memory_order_release );
+  wake_peer();
+}
+
+uint64_t SharedMemoryBridge::End::available_capacity() const
+{
+  return tx_.buffer.size() - ( tx_.tail.load( memory_order_relaxed ) - tx_.head.load( memory_order_acquire ) );
+}
+
+string_view SharedMemoryBridge::End::peek() const
+{
+  const uint64_t head = rx_.head.load( memory_order_relaxed );
+  const uint64_t mask = rx_.buffer.size() - 1;
+  const uint64_t len = min( bytes_buffered(), rx_.buffer.size() - ( head & mask ) );
+  return { rx_.buffer.data() + ( head & mask ), len };
+}
+
+void SharedMemoryBridge::End::pop( uint64_t len )
+{
+  rx_.head.store( rx_.head.load( memory_order_relaxed ) + min( len, bytes_buffered() ), memory_order_release );
+  wake_peer();
+}
+
+uint64_t SharedMemoryBridge::End::bytes_buffered() const
+{
+  return rx_.tail.load( memory_order_acquire ) - rx_.head.load( memory_order_relaxed );
+}
+
+bool SharedMemoryBridge::End::is_finished() const
+{
+  // the writer closes after its last write, so once the close is seen, so are all the bytes
+  return rx_.closed.load( memory_order_acquire ) and bytes_buffered() == 0;
+}
+
+void SharedMemoryBridge::End::arm()
+{
+  armed_.store( true );
+  atomic_thread_fence( memory_order_seq_cst );
+}
+
+void SharedMemoryBridge::End::clear()
+{
+  event_.clear();
+}
+
+void SharedMemoryBridge::End::wait()
+{
+  pollfd event { event_.fd_num(), POLLIN, 0 };
+  CheckSystemCall( "poll", ::poll( &event, 1, -1 ) );
+  clear();
+}
+
+void SharedMemoryBridge::End::wake_peer()
+{
+  // pairs with the fence in arm(): either the peer's second look sees what we did, or we see it armed
+  atomic_thread_fence( memory_order_seq_cst );
+  if ( peer_->armed_.load( memory_order_relaxed ) and peer_->armed_.exchange( false ) ) {
+    peer_->event_.notify();
+  }
+}
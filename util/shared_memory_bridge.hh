@@ -0,0 +1,116 @@
+#pragma once
+
+#include "eventfd.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+//! \brief A pair of byte streams between two threads of one process, through shared memory
+//!
+//! Each direction is a lock-free single-producer, single-consumer ring of bytes, so moving bytes costs one copy
+//! in and one copy out, and no system call. Each end also has an eventfd to sleep on (with poll() or an
+//! EventLoop rule). The other end writes to it only when this end has said, with arm(), that it is about to
+//! sleep, so a steady flow of bytes wakes nobody.
+class SharedMemoryBridge
+{
+  //! One direction: a ring of bytes, and whether the writer is done
+  struct Ring
+  {
+    std::vector<char> buffer;
+    alignas( 64 ) std::atomic<uint64_t> head { 0 }; //!< Bytes popped so far (written by the reader)
+    alignas( 64 ) std::atomic<uint64_t> tail { 0 }; //!< Bytes written so far (written by the writer)
+    std::atomic_bool closed { false };
+
+    explicit Ring( size_t capacity );
+  };
+
+public:
+  static constexpr size_t DEFAULT_CAPACITY = 1 << 18; //!< Default size of each ring, in bytes
+
+  //! One thread's end of the bridge: it writes one ring and reads the other, with an interface like ByteStream's
+  class End
+  {
+  public:
+    //! Copy as much of `data` as fits into the ring to the other end; returns the number of bytes copied
+    size_t write( std::string_view data );
+
+    //! Signal that no more bytes will be written to the other end
+    void close();
+
+    //! Has close() been called?
+    bool is_closed() const { return tx_.closed.load( std::memory_order_acquire ); }
+
+    //! Number of bytes that write() can copy right now
+    uint64_t available_capacity() const;
+
+    //! Bytes from the other end, in place (the first contiguous run of them)
+    std::string_view peek() const;
+
+    //! Consume bytes from the other end
+    void pop( uint64_t len );
+
+    //! Number of bytes from the other end not yet popped
+    uint64_t bytes_buffered() const;
+
+    //! Has the other end closed, and have all its bytes been popped?
+    bool is_finished() const;
+
+    //! \brief Before sleeping on fd(): ask the other end to wake this one when it next writes, closes or pops
+    //!
+    //! After arm(), look once more for bytes or room; anything the other end does after arm() makes fd()
+    //! readable (and anything it did before, the second look finds).
+    void arm();
+
+    //! Becomes readable when the other end has done something since arm()
+    EventFD& fd() { return event_; }
+
+    //! After waking: reset fd()
+    void clear();
+
+    //! Sleep on fd() until the other end does something (call arm() and look again first), then clear()
+    void wait();
+
+    End( const End& ) = delete;
+    End& operator=( const End& ) = delete;
+
+  private:
+    friend class SharedMemoryBridge;
+
+    End( Ring& tx, Ring& rx );
+
+    Ring& tx_;
+    Ring& rx_;
+    End* peer_ {};
+    EventFD event_ {};
+    std::atomic_bool armed_ { false };
+
+    void wake_peer();
+  };
+
+  //! Construct with rings of `capacity` bytes (rounded up to a power of two)
+  explicit SharedMemoryBridge( size_t capacity = DEFAULT_CAPACITY );
+
+  //! The two ends (for the socket's owner and for its TCP thread)
+  End& owner() { return owner_; }
+  End& thread() { return thread_; }
+
+  //! \name
+  //! The ends refer to the rings and to each other, so the bridge cannot be moved or copied
+
+  //!@{
+  SharedMemoryBridge( const SharedMemoryBridge& ) = delete;
+  SharedMemoryBridge( SharedMemoryBridge&& ) = delete;
+  SharedMemoryBridge& operator=( const SharedMemoryBridge& ) = delete;
+  SharedMemoryBridge& operator=( SharedMemoryBridge&& ) = delete;
+  ~SharedMemoryBridge() = default;
+  //!@}
+
+private:
+  Ring to_thread_;
+  Ring to_owner_;
+  End owner_ { to_thread_, to_owner_ };
+  End thread_ { to_owner_, to_thread_ };
+};
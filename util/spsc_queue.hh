@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+//! \brief A bounded, lock-free queue between exactly one producer thread and one consumer thread
+//!
+//! A ring of slots with a head index (advanced only by the consumer) and a tail index (advanced only by the
+//! producer), each on its own cache line so the two threads do not bounce a line between them on every
+//! operation. Each side keeps a cached copy of the other's index and reloads it only when the ring looks
+//! full (or empty).
+template<typename T>
+class SPSCQueue
+{
+public:
+  //! Construct with room for at least `capacity` items (rounded up to a power of two)
+  explicit SPSCQueue( size_t capacity )
+    : slots_( std::bit_ceil( std::max<size_t>( capacity, 2 ) ) ), mask_( slots_.size() - 1 )
+  {}
+
+  //! Producer: add an item, unless the queue is full (then returns false and leaves `item` alone)
+  bool push( T&& item )
+  {
+    const size_t tail = tail_.load( std::memory_order_relaxed );
+    if ( tail - head_cache_ == slots_.size() ) {
+      head_cache_ = head_.load( std::memory_order_acquire );
+      if ( tail - head_cache_ == slots_.size() ) {
+        return false;
+      }
+    }
+    slots_[tail & mask_] = std::move( item );
+    tail_.store( tail + 1, std::memory_order_release );
+    return true;
+  }
+
+  //! Consumer: take the oldest item, if any
+  std::optional<T> pop()
+  {
+    const size_t head = head_.load( std::memory_order_relaxed );
+    if ( head == tail_cache_ ) {
+      tail_cache_ = tail_.load( std::memory_order_acquire );
+      if ( head == tail_cache_ ) {
+        return std::nullopt;
+      }
+    }
+    std::optional<T> item { std::move( slots_[head & mask_] ) };
+    head_.store( head + 1, std::memory_order_release );
+    return item;
+  }
+
+  //! Whether the queue is empty (exact only from the consumer's side; a hint from anywhere else)
+  bool empty() const { return head_.load( std::memory_order_acquire ) == tail_.load( std::memory_order_acquire ); }
+
+  //! Number of slots
+  size_t capacity() const { return slots_.size(); }
+
+private:
+  std::vector<T> slots_;
+  size_t mask_;
+
+  alignas( 64 ) std::atomic<size_t> head_ { 0 };  //!< Next slot to pop (written by the consumer)
+  size_t tail_cache_ { 0 };                       //!< The consumer's last look at tail_
+
+  alignas( 64 ) std::atomic<size_t> tail_ { 0 };  //!< Next slot to push (written by the producer)
+  size_t head_cache_ { 0 };                       //!< The producer's last look at head_
+};
@@ -0,0 +1,308 @@
+#pragma once
+
+#include "address.hh"
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "tcp_config.hh"
+#include "tcp_connection_manager.hh"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+class TCPAsyncStack;
+
+//! \brief A connection handler: a coroutine that TCPAsyncStack::spawn() runs on the stack's thread
+//!
+//! The coroutine starts when it is spawned, runs until its first co_await that cannot complete at once, and
+//! is resumed by the stack's event loop when that operation can. Its frame is freed when it returns.
+class TCPAsyncTask
+{
+public:
+  struct promise_type
+  {
+    TCPAsyncStack* stack {};
+
+    TCPAsyncTask get_return_object() { return TCPAsyncTask { Handle::from_promise( *this ) }; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept;
+    void return_void() {}
+    void unhandled_exception();
+  };
+
+  TCPAsyncTask( TCPAsyncTask&& other ) noexcept : handle_( std::exchange( other.handle_, {} ) ) {}
+  TCPAsyncTask& operator=( TCPAsyncTask&& other ) = delete;
+  TCPAsyncTask( const TCPAsyncTask& ) = delete;
+  TCPAsyncTask& operator=( const TCPAsyncTask& ) = delete;
+
+  //! A task that was never spawned is destroyed without running
+  ~TCPAsyncTask();
+
+private:
+  friend class TCPAsyncStack;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  explicit TCPAsyncTask( Handle handle ) : handle_( handle ) {}
+
+  Handle handle_;
+};
+
+//! \brief An operation a coroutine is suspended on, until the stack finds that it can complete
+//!
+//! Awaiters live in the suspended coroutine's frame. The stack files each one under the connection (or, for an
+//! accept, the port) it waits on, and looks at it again only when the manager has acted on that connection.
+class TCPAsyncWaiter
+{
+public:
+  //! Try to complete the operation (or to make progress on it); returns whether the coroutine can resume
+  virtual bool try_complete() = 0;
+
+  bool await_ready() { return try_complete(); }
+  void await_suspend( std::coroutine_handle<> handle );
+
+  //! \name
+  //! The stack refers to a suspended awaiter, so it stays where it is
+
+  //!@{
+  TCPAsyncWaiter( const TCPAsyncWaiter& ) = delete;
+  TCPAsyncWaiter& operator=( const TCPAsyncWaiter& ) = delete;
+  //!@}
+
+protected:
+  //! Wait for something to happen to connection `id`
+  TCPAsyncWaiter( TCPAsyncStack& stack, const FourTuple& id ) : stack_( &stack ), waited_id_( id ) {}
+
+  //! Wait for a connection to `port` to be established
+  TCPAsyncWaiter( TCPAsyncStack& stack, uint16_t port ) : stack_( &stack ), waited_port_( port ) {}
+
+  ~TCPAsyncWaiter() = default;
+
+  TCPAsyncStack* stack_;
+
+private:
+  friend class TCPAsyncStack;
+
+  std::optional<FourTuple> waited_id_ {}; // the connection waited on (none for an accept)
+  uint16_t waited_port_ {};              // the port an accept waits on
+  std::coroutine_handle<> handle_ {};
+};
+
+//! \brief An established connection on a TCPAsyncStack, with awaitable reads and writes
+//!
+//! Reads and writes go straight to the connection's TCPPeer on the stack's thread: there is no TCP thread
+//! and no socket pair between the handler and the connection.
+class TCPAsyncConnection
+{
+public:
+  class ReadAwaiter final : public TCPAsyncWaiter
+  {
+  public:
+    ReadAwaiter( TCPAsyncConnection& connection, std::string& buffer );
+    bool try_complete() override;
+    size_t await_resume();
+
+  private:
+    TCPAsyncConnection& connection_;
+    std::string& buffer_;
+  };
+
+  class WriteAwaiter final : public TCPAsyncWaiter
+  {
+  public:
+    WriteAwaiter( TCPAsyncConnection& connection, std::string_view data );
+    bool try_complete() override;
+    void await_resume();
+
+  private:
+    TCPAsyncConnection& connection_;
+    std::string_view data_;
+  };
+
+  static constexpr size_t DEFAULT_READ_SIZE = 16384; //!< Most bytes read into an empty buffer
+
+  //! `co_await read( buffer )` waits for bytes from the peer, and reads as many as fit in `buffer` (up to
+  //! DEFAULT_READ_SIZE if it is empty), resizing it to the number read. Returns that number, or 0 at the end of
+  //! the stream; throws if the connection was reset.
+  ReadAwaiter read( std::string& buffer ) { return { *this, buffer }; }
+
+  //! `co_await write( data )` copies `data` into the outbound stream as room frees up, and returns once all of
+  //! it has been copied (it need not have been sent yet); throws if the connection was reset. `data` must stay
+  //! valid until then.
+  WriteAwaiter write( std::string_view data ) { return { *this, data }; }
+
+  //! End the outbound stream (a FIN follows the bytes already written)
+  void close();
+
+  //! The connection's 4-tuple
+  const FourTuple& id() const { return id_; }
+
+  //! Address and port of the remote peer
+  Address peer_address() const
+  {
+    return Address { Address::from_ipv4_numeric( id_.remote_ip ).ip(), id_.remote_port };
+  }
+
+  TCPAsyncConnection( TCPAsyncStack& stack, const FourTuple& id ) : stack_( &stack ), id_( id ) {}
+
+  //! \name
+  //! A connection can be moved to the handler that serves it, but not copied
+
+  //!@{
+  TCPAsyncConnection( TCPAsyncConnection&& other ) noexcept;
+  TCPAsyncConnection& operator=( TCPAsyncConnection&& other ) = delete;
+  TCPAsyncConnection( const TCPAsyncConnection& ) = delete;
+  TCPAsyncConnection& operator=( const TCPAsyncConnection& ) = delete;
+  //!@}
+
+  //! Close the outbound stream, and discard whatever else arrives, so that the connection can finish
+  ~TCPAsyncConnection();
+
+private:
+  TCPAsyncStack* stack_;
+  FourTuple id_;
+};
+
+//! Established connections to a listening port, handed out by `co_await accept()`
+class TCPAsyncListener
+{
+public:
+  class AcceptAwaiter final : public TCPAsyncWaiter
+  {
+  public:
+    AcceptAwaiter( TCPAsyncStack& stack, uint16_t port ) : TCPAsyncWaiter( stack, port ), port_( port ) {}
+    bool try_complete() override;
+    TCPAsyncConnection await_resume();
+
+  private:
+    uint16_t port_;
+    FourTuple id_ {};
+  };
+
+  TCPAsyncListener( TCPAsyncStack& stack, uint16_t port ) : stack_( &stack ), port_( port ) {}
+
+  //! `co_await accept()` waits for the next established connection
+  AcceptAwaiter accept() { return { *stack_, port_ }; }
+
+  //! The port listened on
+  uint16_t port() const { return port_; }
+
+private:
+  TCPAsyncStack* stack_;
+  uint16_t port_;
+};
+
+//! \brief A single-threaded TCP stack whose connections are served by coroutines
+//!
+//! One TCPConnectionManager and one EventLoop serve every connection from a datagram device, on the thread
+//! that calls run(). The application spawns coroutines (TCPAsyncTask) that co_await accept(), connect(),
+//! read() and write(); a suspended coroutine costs its frame, and is resumed by the loop once its operation
+//! can complete. So one thread can serve thousands of connections, without a thread or a socket pair for
+//! each (as TCPMinnowSocket needs) and without writing EventLoop rules by hand (as TCPMinnowListener does).
+class TCPAsyncStack
+{
+public:
+  class ConnectAwaiter final : public TCPAsyncWaiter
+  {
+  public:
+    ConnectAwaiter( TCPAsyncStack& stack, const FourTuple& id ) : TCPAsyncWaiter( stack, id ), id_( id ) {}
+    bool try_complete() override;
+    TCPAsyncConnection await_resume();
+
+  private:
+    FourTuple id_;
+  };
+
+  //! Serve connections with configuration `cfg` over `device`, which carries one IPv4 datagram per read and
+  //! write (a TUN device, or e.g. a SOCK_SEQPACKET socket)
+  TCPAsyncStack( FileDescriptor&& device, const TCPConfig& cfg );
+
+  //! Accept connections to `port` (see TCPConnectionManager::listen)
+  TCPAsyncListener listen( uint16_t port,
+                           size_t syn_backlog = TCPConnectionManager::DEFAULT_BACKLOG,
+                           size_t accept_backlog = TCPConnectionManager::DEFAULT_BACKLOG );
+
+  //! `co_await connect( local, remote )` opens a connection, and waits until it is established; throws if the
+  //! handshake fails
+  ConnectAwaiter connect( const Address& local, const Address& remote );
+
+  //! Start a coroutine; it runs until its first co_await that has to wait
+  void spawn( TCPAsyncTask task );
+
+  //! Serve connections and resume coroutines until every spawned coroutine has returned and every connection
+  //! has closed; rethrows an exception that escapes a coroutine
+  void run();
+
+  //! The stack's connections
+  TCPConnectionManager& manager() { return manager_; }
+
+  //! The stack's event loop (the application can add its own rules to it)
+  EventLoop& eventloop() { return eventloop_; }
+
+  //! Destroys the frames of coroutines that have not returned
+  ~TCPAsyncStack();
+
+  //! \name
+  //! Coroutines and connections refer to the stack, so it cannot be moved or copied
+
+  //!@{
+  TCPAsyncStack( const TCPAsyncStack& ) = delete;
+  TCPAsyncStack( TCPAsyncStack&& ) = delete;
+  TCPAsyncStack& operator=( const TCPAsyncStack& ) = delete;
+  TCPAsyncStack& operator=( TCPAsyncStack&& ) = delete;
+  //!@}
+
+private:
+  friend struct TCPAsyncTask::promise_type;
+  friend class TCPAsyncWaiter;
+  friend class TCPAsyncConnection;
+  friend class TCPAsyncConnection::ReadAwaiter;
+  friend class TCPAsyncConnection::WriteAwaiter;
+  friend class TCPAsyncListener::AcceptAwaiter;
+
+  FileDescriptor device_;
+  TCPConnectionManager manager_;
+  EventLoop eventloop_ {};
+
+  using Waiters = std::vector<TCPAsyncWaiter*>;
+
+  std::unordered_set<void*> tasks_ {};                               //!< Frames of coroutines not yet returned
+  std::unordered_map<FourTuple, Waiters, FourTupleHash> waiting_ {}; //!< Suspended awaiters, by connection
+  std::unordered_map<uint16_t, Waiters> accepting_ {};               //!< Suspended accepts, by port
+  std::unordered_set<FourTuple, FourTupleHash> active_ {};           //!< Connections whose awaiters need a look
+  std::vector<FourTuple> orphans_ {};                                //!< Connections whose TCPAsyncConnection died
+  std::exception_ptr error_ {};                                      //!< An exception that escaped a coroutine
+
+  //! Forget a coroutine that has returned, and free its frame
+  void finish( std::coroutine_handle<> task );
+
+  //! Resume the coroutines waiting on connections the manager has acted on whose operations can complete, until
+  //! none can
+  void resume_ready();
+
+  //! Resume the coroutines filed under `key` in `waiting` whose operations can complete
+  template<class Key, class Map>
+  void resume_ready( Map& waiting, const Key& key );
+
+  //! Read and discard what arrives on orphaned connections, and forget the ones that have finished
+  void drain_orphans();
+};
+
+inline auto TCPAsyncTask::promise_type::final_suspend() noexcept
+{
+  // the stack forgets the coroutine, and its frame is freed
+  struct FinalAwaiter
+  {
+    bool await_ready() noexcept { return false; }
+    void await_suspend( Handle handle ) noexcept { handle.promise().stack->finish( handle ); }
+    void await_resume() noexcept {}
+  };
+  return FinalAwaiter {};
+}
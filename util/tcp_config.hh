@@ -6,6 +6,17 @@
 #include <cstddef>
 #include <cstdint>
 #include <optional>
+#include <string>
+
+//! Path properties measured by an earlier connection to the same destination (see tcp_metrics.hh)
+class TCPMetrics
+{
+public:
+  uint64_t srtt_ms {};    //!< Smoothed round-trip time, in milliseconds
+  uint64_t rttvar_ms {};  //!< Round-trip time variation, in milliseconds
+  uint64_t min_rtt_ms {}; //!< Smallest round-trip time seen, which sets RACK's reordering window
+  uint64_t ssthresh {};   //!< Slow-start threshold (0 = the connection never left slow start)
+};
 
 //! Config for TCP sender and receiver
 class TCPConfig
@@ -13,13 +24,45 @@ class TCPConfig
 public:
   static constexpr size_t DEFAULT_CAPACITY = 64000; //!< Default capacity
   static constexpr size_t MAX_PAYLOAD_SIZE = 1000;  //!< Conservative max payload size for real Internet
+  static constexpr uint16_t DEFAULT_MSS = 1460;     //!< 1500-byte Ethernet MTU minus IPv4 and TCP headers
+  static constexpr uint16_t MIN_MSS = 88;          //!< Smallest MSS accepted from a peer (as Linux's TCP_MIN_MSS)
   static constexpr uint16_t TIMEOUT_DFLT = 1000;    //!< Default re-transmit timeout is 1 second
   static constexpr unsigned MAX_RETX_ATTEMPTS = 8;  //!< Maximum re-transmit attempts before giving up
+  static constexpr size_t GSO_MAX_SIZE = 65536;     //!< Largest payload of a segmentation-offload super-segment
+  static constexpr size_t MAX_WINDOW = UINT16_MAX;  //!< Largest window the header can advertise (no window scaling)
 
   uint16_t rt_timeout = TIMEOUT_DFLT;      //!< Initial value of the retransmission timeout, in milliseconds
-  size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes
+  bool adaptive_rto = true;                //!< Derive the RTO from the measured RTT (RFC 6298) after rt_timeout
+  size_t recv_capacity = DEFAULT_CAPACITY; //!< Receive capacity, in bytes (initial capacity when auto-tuning)
   size_t send_capacity = DEFAULT_CAPACITY; //!< Sender capacity, in bytes
   Wrap32 isn { 137 };                      //!< Default initial sequence number
+  uint16_t mss = DEFAULT_MSS;              //!< MSS announced on our SYN, and upper bound on outgoing segments
+  bool mtu_probing = false;                //!< Probe for larger segments (RFC 4821) instead of trusting the MSS
+  bool trim_partial_acks = true;           //!< Retransmit only the unacknowledged tail of a partially ACKed segment
+  bool collapse_retransmits = true;        //!< On timeout, merge small outstanding segments up to one MSS
+  bool nagle = true;                       //!< Hold a small segment while an earlier small one is unacknowledged
+  bool autocork = false;                   //!< Hold small segments while any data is in flight
+  uint16_t cork_timeout_ms = 200;          //!< Longest a corked small segment is held back, in milliseconds
+  bool pacing = false;                     //!< Spread new segments over the RTT instead of sending in bursts
+  uint64_t pacing_rate_cap = 0;            //!< Upper bound on the pacing rate, in bytes per second (0 = none)
+  bool gso = false;                        //!< Hand the adapter super-segments of up to GSO_MAX_SIZE bytes
+  bool rack_tlp = true;                    //!< Time-based loss detection (RACK) and tail loss probes (TLP)
+  bool frto = true;                        //!< Detect spurious retransmission timeouts (F-RTO) and undo them
+  bool congestion_control = true;          //!< Limit the flight to a congestion window (slow start, AIMD)
+  bool ecn = false;                        //!< Negotiate ECN; needs congestion_control to respond to marks
+  bool persist_timer = true;               //!< Probe a zero window with backoff instead of resending data
+  bool fastopen = false;                   //!< TCP Fast Open: send data on the SYN with the server's cookie
+  bool delayed_ack = true;                 //!< ACK in-order data every second full segment or after a timer
+  uint16_t delayed_ack_ms = 40;            //!< Longest a pure ACK is delayed, in milliseconds
+  uint16_t quick_ack_segments = 16;        //!< ACK this many initial data segments immediately (slow start)
+  uint16_t stretch_ack_segments = 0;       //!< ACK every this many full segments while data streams in (0 = 2)
+  bool receiver_sws_avoidance = true;      //!< Hold back window updates smaller than min(MSS, half the buffer)
+  bool recv_autotune = false;              //!< Grow the receive buffer to what the application drains per RTT
+  size_t recv_capacity_max = MAX_WINDOW;   //!< Largest the receive buffer may grow to (at most MAX_WINDOW)
+  uint16_t recv_idle_ms = 1000;            //!< Shrink the receive buffer back after this long without data
+
+  std::optional<std::string> fastopen_cookie {}; //!< Client: TFO cookie from an earlier connection (see fastopen)
+  std::optional<TCPMetrics> metrics {};          //!< Path measurements from an earlier connection to start from
 };
 
 //! Config for classes derived from FdAdapter
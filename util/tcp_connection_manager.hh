@@ -0,0 +1,154 @@
+#pragma once
+
+#include "address.hh"
+#include "eventloop.hh"
+#include "file_descriptor.hh"
+#include "ipv4_datagram.hh"
+#include "tcp_config.hh"
+#include "tcp_peer.hh"
+#include "tun.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//! The addresses and ports of a TCP connection, from the local end's point of view
+struct FourTuple
+{
+  uint32_t local_ip {};
+  uint16_t local_port {};
+  uint32_t remote_ip {};
+  uint16_t remote_port {};
+
+  bool operator==( const FourTuple& other ) const = default;
+};
+
+//! Hash of a 4-tuple, for the connection table (and for spreading flows, like a NIC's receive-side scaling)
+struct FourTupleHash
+{
+  size_t operator()( const FourTuple& id ) const noexcept;
+};
+
+//! \brief Many TCP connections over one stream of IPv4 datagrams
+//!
+//! Each incoming datagram is demultiplexed by its 4-tuple to the TCPPeer of its connection, through a hash
+//! table; a SYN to a listening port opens a new connection (see listen), and a segment for no connection is
+//! answered with a RST. What the connections send comes out as IPv4 datagrams. One thread and one event loop
+//! can serve thousands of connections from one TUN device this way (see install_rules), where a
+//! TCPMinnowSocket needs an adapter and a thread for each.
+class TCPConnectionManager
+{
+public:
+  static constexpr size_t DEFAULT_BACKLOG = 128; //!< Default length of a listening port's SYN and accept queues
+
+  //! Construct with the configuration of every connection
+  explicit TCPConnectionManager( const TCPConfig& cfg ) : cfg_( cfg ) {}
+
+  //! Open a connection from `local` to `remote` (the SYN goes out at once); throws if the 4-tuple is in use
+  FourTuple connect( const Address& local, const Address& remote );
+
+  //! Accept connections to `port` on any local address. Up to `syn_backlog` connections can be half-open at a
+  //! time (a SYN beyond that is dropped, and the client will send it again), and up to `accept_backlog`
+  //! established connections can wait in accepted() (the others stay in the SYN queue until there is room).
+  //! A half-open connection whose SYN-ACK goes unacknowledged after MAX_RETX_ATTEMPTS retransmissions is
+  //! dropped.
+  void listen( uint16_t port, size_t syn_backlog = DEFAULT_BACKLOG, size_t accept_backlog = DEFAULT_BACKLOG );
+
+  //! Established connections to a listening port, in order of completion, for the application to pick up
+  //! (a connection that has since been reset is no longer found)
+  std::queue<FourTuple>& accepted( uint16_t port ) { return listeners_.at( port ).accept_queue; }
+
+  //! Number of half-open connections to a listening port
+  size_t half_open( uint16_t port ) const { return listeners_.at( port ).syn_queue.size(); }
+
+  //! The connection with this 4-tuple, or nullptr if there is none (any more; see tick)
+  TCPPeer* find( const FourTuple& id );
+
+  //! Send what the application has written to a connection's outbound stream
+  void push( const FourTuple& id );
+
+  //! Tell a connection's peer about receive space the application has freed (see TCPPeer::update_window)
+  void update_window( const FourTuple& id );
+
+  //! Demultiplex an incoming datagram to its connection
+  void receive( const InternetDatagram& dgram );
+
+  //! Time has passed: tick the connections that have work due (see ms_until_next_tick), and drop the ones that
+  //! have finished and been read to the end. The others catch up on the elapsed time when next touched, so a
+  //! tick costs O(log n) per due connection rather than a pass over all of them.
+  void tick( uint64_t ms_since_last_tick );
+
+  //! How long until tick() next has work to do for some connection (see TCPPeer::ms_until_next_tick), or
+  //! nullopt if none does until a datagram arrives
+  std::optional<uint64_t> ms_until_next_tick() const;
+
+  //! Have `callback` called with a connection's 4-tuple whenever receive(), tick(), push() or update_window() acts
+  //! on it (including dropping it), so that whatever waits on a connection can be looked at again only when
+  //! something has happened to it
+  void on_activity( std::function<void( const FourTuple& )> callback ) { on_activity_ = std::move( callback ); }
+
+  //! Datagrams the connections have sent, for the caller to put on the wire
+  std::queue<InternetDatagram>& datagrams_out() { return datagrams_out_; }
+
+  //! Serve from a TUN device on `loop`: datagrams that arrive on it are demultiplexed, and datagrams sent are
+  //! written to it (the caller keeps calling tick() as time passes). Any file descriptor that carries one IPv4
+  //! datagram per read and write will do, such as a SOCK_SEQPACKET socket.
+  void install_rules( EventLoop& loop, FileDescriptor& tun );
+
+  //! Number of open connections
+  size_t size() const { return connections_.size(); }
+
+private:
+  struct Connection
+  {
+    TCPPeer peer;
+    TCPPeer::TransmitFunction transmit {};
+    bool half_open {};                      // passively opened, and still in its listener's SYN queue
+    uint64_t ticked_ms {};                  // manager time the peer has been ticked up to
+    std::optional<uint64_t> deadline_ms {}; // manager time the peer next has work to do (its entry in timers_)
+
+    explicit Connection( const TCPConfig& cfg ) : peer( cfg ) {}
+  };
+
+  // An entry in the timer heap; it is stale (and skipped) once the connection's deadline has moved on
+  struct Timer
+  {
+    uint64_t due_ms;
+    FourTuple id;
+
+    bool operator>( const Timer& other ) const { return due_ms > other.due_ms; }
+  };
+
+  struct Listener
+  {
+    size_t syn_backlog;
+    size_t accept_backlog;
+    std::deque<FourTuple> syn_queue {};    // half-open connections, oldest first
+    std::queue<FourTuple> accept_queue {}; // established connections the application has not picked up yet
+  };
+
+  TCPConfig cfg_;
+  std::unordered_map<FourTuple, Connection, FourTupleHash> connections_ {};
+  std::unordered_map<uint16_t, Listener> listeners_ {};
+  std::queue<InternetDatagram> datagrams_out_ {};
+
+  uint64_t now_ms_ {};                                                       // sum of all ticks
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_ {}; // earliest deadline on top
+  std::unordered_set<FourTuple, FourTupleHash> polled_ {};                   // checked on every tick
+  std::function<void( const FourTuple& )> on_activity_ {};
+
+  Connection& open( const FourTuple& id, const TCPConfig& cfg );
+  void catch_up( Connection& connection );
+  void schedule( const FourTuple& id, Connection& connection );
+  bool stale( const Timer& timer ) const;
+  void drop_stale_timers();
+  bool try_accept( const FourTuple& id, Connection& connection );
+  void send( const FourTuple& id, const TCPMessage& msg );
+  void reset( const FourTuple& id, const TCPMessage& msg );
+};
@@ -0,0 +1,57 @@
+#include "tcp_fastopen.hh"
+#include "random.hh"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+// splitmix64's finalizer: every bit of the input affects every bit of the output
+static uint64_t mix( uint64_t x )
+{
+  x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9;
+  x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111eb;
+  return x ^ ( x >> 31 );
+}
+
+// The server's secret, chosen once per process (restarting the server invalidates the cookies it issued)
+static uint64_t secret_key()
+{
+  static const uint64_t key = [] {
+    auto rng = get_random_engine();
+    return ( static_cast<uint64_t>( rng() ) << 32 ) ^ rng();
+  }();
+  return key;
+}
+
+static mutex cache_mutex;
+static unordered_map<uint32_t, string> cookie_cache; // server IPv4 address => cookie
+
+string fastopen_cookie_for( const Address& client )
+{
+  // Not a cryptographic MAC (RFC 7413 suggests AES), but unpredictable without the key
+  uint64_t tag = mix( mix( secret_key() ) ^ client.ipv4_numeric() );
+  string cookie( sizeof( tag ), 0 );
+  for ( auto& byte : cookie ) {
+    byte = static_cast<char>( tag & 0xff );
+    tag >>= 8;
+  }
+  return cookie;
+}
+
+optional<string> cached_fastopen_cookie( const Address& server )
+{
+  const lock_guard lock( cache_mutex );
+  const auto it = cookie_cache.find( server.ipv4_numeric() );
+  if ( it == cookie_cache.end() ) {
+    return nullopt;
+  }
+  return it->second;
+}
+
+void cache_fastopen_cookie( const Address& server, const string& cookie )
+{
+  const lock_guard lock( cache_mutex );
+  cookie_cache[server.ipv4_numeric()] = cookie;
+}
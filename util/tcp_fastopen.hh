@@ -0,0 +1,22 @@
+#pragma once
+
+#include "address.hh"
+
+#include <optional>
+#include <string>
+
+//! \file
+//! TCP Fast Open (RFC 7413) cookies.
+//!
+//! A server issues each client a cookie derived from the client's IPv4 address and a secret key, so a
+//! client can only use the cookie from the address it was issued to. A client remembers the cookie each
+//! server handed it, so its next connection to that server can carry data on the SYN.
+
+//! The cookie this host, as a server, issues to a client at the IPv4 address of `client`
+std::string fastopen_cookie_for( const Address& client );
+
+//! The cookie the server at the IPv4 address of `server` handed out earlier, if any
+std::optional<std::string> cached_fastopen_cookie( const Address& server );
+
+//! Remember the cookie the server at the IPv4 address of `server` handed out
+void cache_fastopen_cookie( const Address& server, const std::string& cookie );
@@ -0,0 +1,49 @@
+#include "tcp_info.hh"
+
+#include <sstream>
+
+using namespace std;
+
+const char* to_string( TCPInfo::State state )
+{
+  switch ( state ) {
+    case TCPInfo::State::listen:
+      return "LISTEN";
+    case TCPInfo::State::syn_sent:
+      return "SYN-SENT";
+    case TCPInfo::State::syn_received:
+      return "SYN-RECEIVED";
+    case TCPInfo::State::established:
+      return "ESTABLISHED";
+    case TCPInfo::State::fin_wait_1:
+      return "FIN-WAIT-1";
+    case TCPInfo::State::fin_wait_2:
+      return "FIN-WAIT-2";
+    case TCPInfo::State::close_wait:
+      return "CLOSE-WAIT";
+    case TCPInfo::State::closing:
+      return "CLOSING";
+    case TCPInfo::State::last_ack:
+      return "LAST-ACK";
+    case TCPInfo::State::time_wait:
+      return "TIME-WAIT";
+    case TCPInfo::State::closed:
+      return "CLOSED";
+    case TCPInfo::State::reset:
+      return "RESET";
+  }
+  return "UNKNOWN";
+}
+
+string TCPInfo::to_string() const
+{
+  stringstream ss {};
+  ss << ::to_string( state ) << " sent=" << bytes_sent << " retrans=" << bytes_retransmitted
+     << " acked=" << bytes_acked << " received=" << bytes_received << " in_flight=" << bytes_in_flight
+     << " segs_out=" << segments_out << " segs_in=" << segments_in << " retransmissions=" << retransmissions
+     << " dup=" << duplicate_segments << " ooo=" << out_of_order_segments << " rtt=" << srtt_ms << "/" << rttvar_ms
+     << "ms rto=" << rto_ms << "ms mss=" << mss << " cwnd=" << cwnd << " ssthresh=" << ssthresh
+     << " snd_wnd=" << send_window << " rcv_wnd=" << receive_window << " rwnd_limited=" << rwnd_limited_ms
+     << "ms cwnd_limited=" << cwnd_limited_ms << "ms app_limited=" << app_limited_ms << "ms";
+  return ss.str();
+}
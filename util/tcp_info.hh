@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//! \brief A snapshot of one connection's counters and state, like Linux's TCP_INFO (see TCPPeer::info())
+//!
+//! Every field is a counter the connection keeps anyway, or is read off its state when the snapshot is taken,
+//! so collecting them costs a few additions per segment and per tick.
+class TCPInfo
+{
+public:
+  //! Connection state, in the terms of RFC 9293 (derived from the sender's and receiver's progress)
+  enum class State : uint8_t
+  {
+    listen,       //!< Nothing sent or received yet
+    syn_sent,     //!< Our SYN is out, the peer's has not arrived
+    syn_received, //!< The peer's SYN has arrived, ours is not acknowledged yet
+    established,  //!< Both streams open
+    fin_wait_1,   //!< We have closed, our FIN is not acknowledged yet
+    fin_wait_2,   //!< We have closed and our FIN is acknowledged, the peer's stream is still open
+    close_wait,   //!< The peer has closed, we have not
+    closing,      //!< Both have closed, we first, and our FIN is not acknowledged yet
+    last_ack,     //!< Both have closed, the peer first, and our FIN is not acknowledged yet
+    time_wait,    //!< Both streams are done, and we linger in case the peer missed our last ACK
+    closed,       //!< The connection is over
+    reset,        //!< The connection was reset (or aborted)
+  };
+
+  State state { State::closed }; //!< Current state
+
+  //! \name
+  //! Stream bytes (payload only, not SYN or FIN)
+
+  //!@{
+  uint64_t bytes_sent {};          //!< Sent for the first time
+  uint64_t bytes_retransmitted {}; //!< Sent again (retransmissions and tail loss probes)
+  uint64_t bytes_acked {};         //!< Acknowledged by the peer
+  uint64_t bytes_received {};      //!< Received in order (i.e. acknowledged to the peer)
+  uint64_t bytes_in_flight {};     //!< Sequence numbers sent but not yet acknowledged
+  //!@}
+
+  //! \name
+  //! Segments (each wire-sized piece of a GSO or GRO super-segment counts)
+
+  //!@{
+  uint64_t segments_out {};          //!< Sent, including pure ACKs, retransmissions and probes
+  uint64_t segments_in {};           //!< Received
+  uint64_t retransmissions {};       //!< Retransmitted (by the timer, fast retransmit or a tail loss probe)
+  uint64_t duplicate_segments {};    //!< Received, but carried only sequence numbers received before
+  uint64_t out_of_order_segments {}; //!< Received beyond a hole, ahead of what was expected next
+  uint64_t spurious_timeouts {};     //!< Retransmission timeouts that F-RTO found to be spurious
+  uint64_t window_probes {};         //!< Zero-window probes sent
+  //!@}
+
+  //! \name
+  //! Round trip and windows
+
+  //!@{
+  uint64_t srtt_ms {};        //!< Smoothed round-trip time (0 before the first sample)
+  uint64_t rttvar_ms {};      //!< Round-trip time variation
+  uint64_t min_rtt_ms {};     //!< Smallest round-trip time seen
+  uint64_t rto_ms {};         //!< Current retransmission timeout
+  uint64_t mss {};            //!< Current maximum payload of outgoing segments
+  uint64_t cwnd {};           //!< Congestion window, in sequence numbers (0 = no congestion control)
+  uint64_t ssthresh {};       //!< Slow-start threshold (0 = the connection never left slow start)
+  uint64_t send_window {};    //!< Window the peer last advertised
+  uint64_t receive_window {}; //!< Window we last advertised
+  //!@}
+
+  //! \name
+  //! What limited the sender, in milliseconds since the handshake, until the whole stream was sent
+
+  //!@{
+  uint64_t rwnd_limited_ms {}; //!< The flight filled the peer's window
+  uint64_t cwnd_limited_ms {}; //!< The flight filled the (smaller) congestion window
+  uint64_t app_limited_ms {};  //!< There was room to send, but the application had written nothing more
+  //!@}
+
+  //! One-line summary, for logs
+  std::string to_string() const;
+};
+
+//! Name of a connection state, e.g. "ESTABLISHED"
+const char* to_string( TCPInfo::State state );
@@ -0,0 +1,26 @@
+#include "tcp_metrics.hh"
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+static mutex metrics_mutex;
+static unordered_map<uint32_t, TCPMetrics> metrics_cache; // destination IPv4 address => metrics
+
+optional<TCPMetrics> cached_tcp_metrics( const Address& destination )
+{
+  const lock_guard lock( metrics_mutex );
+  const auto it = metrics_cache.find( destination.ipv4_numeric() );
+  if ( it == metrics_cache.end() ) {
+    return nullopt;
+  }
+  return it->second;
+}
+
+void cache_tcp_metrics( const Address& destination, const TCPMetrics& metrics )
+{
+  const lock_guard lock( metrics_mutex );
+  metrics_cache[destination.ipv4_numeric()] = metrics;
+}
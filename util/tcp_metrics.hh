@@ -0,0 +1,19 @@
+#pragma once
+
+#include "address.hh"
+#include "tcp_config.hh"
+
+#include <optional>
+
+//! \file
+//! Per-destination TCP metrics, like Linux's tcp_metrics.
+//!
+//! When a connection closes, what it measured about the path (RTT, RTT variation, slow-start threshold) is
+//! kept under the peer's IPv4 address; the next connection to or from that address starts from it instead
+//! of from TCPConfig::rt_timeout and an unbounded slow start.
+
+//! What the last connection to the IPv4 address of `destination` measured, if any
+std::optional<TCPMetrics> cached_tcp_metrics( const Address& destination );
+
+//! Remember what a connection to the IPv4 address of `destination` measured
+void cache_tcp_metrics( const Address& destination, const TCPMetrics& metrics );
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "address.hh"
+#include "eventfd.hh"
+#include "eventloop.hh"
+#include "socket.hh"
+#include "tcp_config.hh"
+#include "tcp_connection_manager.hh"
+#include "tun.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+//! A connection handed out by TCPMinnowListener::accept(): a local stream socket whose other end the
+//! listener's TCP thread connects to the connection's TCPPeer
+class TCPMinnowConnection : public LocalStreamSocket
+{
+public:
+  TCPMinnowConnection( LocalStreamSocket&& socket, const Address& peer )
+    : LocalStreamSocket( std::move( socket ) ), _peer( peer )
+  {}
+
+  //! Address and port of the remote peer
+  const Address& peer_address() const { return _peer; }
+
+private:
+  Address _peer;
+};
+
+//! \brief A listening socket on the minnow stack
+//!
+//! One TCP thread serves a port, and every connection to it, from a TUN device through a
+//! TCPConnectionManager. Handshakes complete concurrently, bounded by a SYN queue and an accept queue (see
+//! TCPConnectionManager::listen), and each call to accept() hands out the next established connection.
+//! (TCPMinnowSocket::listen_and_accept, by contrast, serves the first client and ignores the others.)
+class TCPMinnowListener
+{
+public:
+  //! Listen on `port` for datagrams that arrive on `tun`
+  TCPMinnowListener( TunFD&& tun,
+                     const TCPConfig& cfg,
+                     uint16_t port,
+                     size_t syn_backlog = TCPConnectionManager::DEFAULT_BACKLOG,
+                     size_t accept_backlog = TCPConnectionManager::DEFAULT_BACKLOG );
+
+  //! Wait for the next established connection
+  TCPMinnowConnection accept();
+
+  //! Stop the TCP thread; connections still open are dropped
+  ~TCPMinnowListener();
+
+  //! \name
+  //! This object cannot be safely moved or copied, since it is in use by two threads simultaneously
+
+  //!@{
+  TCPMinnowListener( const TCPMinnowListener& ) = delete;
+  TCPMinnowListener( TCPMinnowListener&& ) = delete;
+  TCPMinnowListener& operator=( const TCPMinnowListener& ) = delete;
+  TCPMinnowListener& operator=( TCPMinnowListener&& ) = delete;
+  //!@}
+
+private:
+  //! The TCP thread's end of an accepted connection's socket pair, and the rules that serve it
+  struct Bridge
+  {
+    FourTuple id;
+    LocalStreamSocket thread_data;
+    bool inbound_shutdown {};  //!< Has the incoming data to the owner been shut down?
+    bool outbound_shutdown {}; //!< Has the owner shut down the outbound data?
+    std::vector<EventLoop::RuleHandle> rules {};
+  };
+
+  TunFD _tun;
+  uint16_t _port;
+
+  //! Connections and the event loop; only the TCP thread touches them
+  TCPConnectionManager _manager;
+  EventLoop _eventloop {};
+  std::list<Bridge> _bridges {};
+  size_t _push_category {};
+  size_t _pull_category {};
+
+  std::mutex _mutex {};
+  std::condition_variable _ready_cv {};
+  size_t _accepts_waiting {};                //!< accept() calls waiting for a connection (guarded by _mutex)
+  std::queue<TCPMinnowConnection> _ready {}; //!< Connections for the waiting accept() calls (guarded by _mutex)
+  std::atomic_bool _abort { false };         //!< Flag used by the owner to shut the TCP thread down
+  EventFD _wakeup {};                        //!< Wakes the TCP thread for an accept() or to shut down
+
+  std::thread _tcp_thread {};
+
+  //! Main loop of the TCP thread
+  void _tcp_main();
+
+  //! Hand established connections to waiting accept() calls
+  void _hand_over_accepted();
+
+  //! Move bytes between an accepted connection's TCPPeer and its socket pair
+  void _bridge( const FourTuple& id, LocalStreamSocket&& thread_data );
+
+  //! Forget connections the manager has dropped
+  void _sweep_bridges();
+};
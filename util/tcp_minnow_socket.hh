@@ -1,8 +1,10 @@
 #pragma once
 
 #include "byte_stream.hh"
+#include "eventfd.hh"
 #include "eventloop.hh"
 #include "file_descriptor.hh"
+#include "shared_memory_bridge.hh"
 #include "socket.hh"
 #include "tcp_config.hh"
 #include "tcp_peer.hh"
@@ -10,10 +12,19 @@
 
 #include <atomic>
 #include <cstdint>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <thread>
 #include <vector>
 
+//! Busy polling for a TCPMinnowSocket (see TCPMinnowSocket::set_busy_poll)
+struct BusyPollConfig
+{
+  uint64_t spin_us = 50;     //!< How long the TCP thread keeps polling without sleeping, in microseconds
+  std::optional<int> cpu {}; //!< CPU to pin the TCP thread to, if any
+};
+
 //! Multithreaded wrapper around TCPPeer that approximates the Unix sockets API
 template<TCPDatagramAdapter AdaptT>
 class TCPMinnowSocket : public LocalStreamSocket
@@ -28,11 +39,38 @@ public:
   void wait_until_closed();
 
   //! Connect using the specified configurations; blocks until connect succeeds or fails
-  void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
+  //! \note With a TCP Fast Open cookie from an earlier connection to the same server, `early_data` (e.g. a
+  //! request) is carried on the SYN and reaches the server's application without waiting for the handshake
+  void connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad, std::string early_data = {} );
 
   //! Listen and accept using the specified configurations; blocks until accept succeeds or fails
   void listen_and_accept( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad );
 
+  //! \name
+  //! Shared-memory bridge: with use_shared_memory() called before connect() or listen_and_accept(), payload
+  //! bytes pass between the owner and the TCP thread through in-process rings instead of the socket pair,
+  //! which saves a copy and a system call each way for every chunk. The owner then reads and writes through
+  //! shared_memory() (whose fd() can be polled) instead of through this socket.
+
+  //!@{
+  void use_shared_memory( size_t capacity = SharedMemoryBridge::DEFAULT_CAPACITY );
+  SharedMemoryBridge::End& shared_memory();
+  //!@}
+
+  //! \brief Low-latency mode: the TCP thread spins before it sleeps (call before connect() or listen_and_accept())
+  //!
+  //! When it runs out of work, the TCP thread keeps polling the datagram interface and the owner's socket (or
+  //! the shared-memory bridge) without blocking for up to `config.spin_us` microseconds, and only then sleeps
+  //! until an event or the next deadline. A reply that arrives within the spin budget is handled without the
+  //! cost of a wakeup, at the price of a busy core. With `config.cpu` set, the TCP thread is pinned to that CPU.
+  void set_busy_poll( const BusyPollConfig& config );
+
+  //! \brief Counters and state of the connection (see TCPPeer::info())
+  //!
+  //! The TCP thread refreshes a copy each time round its loop, which this returns, so it is as current as the
+  //! last event or timer the thread handled (and stays available once the connection is over).
+  TCPInfo info() const;
+
   //! When a connected socket is destructed, it will send a RST
   ~TCPMinnowSocket();
 
@@ -66,6 +104,18 @@ private:
   //! Stream socket for reads and writes between owner and TCP thread
   LocalStreamSocket _thread_data;
 
+  //! In-process rings that replace _thread_data, if the owner asked for them
+  std::optional<SharedMemoryBridge> _bridge {};
+
+  //! Move bytes between the TCPPeer and the shared-memory bridge; returns whether any moved
+  bool _pump_bridge();
+
+  //! Busy polling, if the owner asked for it
+  std::optional<BusyPollConfig> _busy_poll {};
+
+  //! Poll without sleeping until an event is handled or bytes move over the bridge, or the spin budget runs out
+  EventLoop::Result _spin();
+
   //! Set up the TCPPeer and the event loop
   void _initialize_TCP( const TCPConfig& config );
 
@@ -81,9 +131,19 @@ private:
   //! Main loop of TCPPeer thread
   void _tcp_main();
 
+  //! Copy of _tcp->info(), for the owner
+  TCPInfo _info {};
+  mutable std::mutex _info_mutex {};
+
+  //! Refresh _info
+  void _publish_info();
+
   //! Handle to the TCPPeer thread; owner thread calls join() in the destructor
   std::thread _tcp_thread {};
 
+  //! Wakes the TCPPeer thread from its sleep (which lasts until an event or the next deadline)
+  EventFD _wakeup {};
+
   //! Construct LocalStreamSocket fds from socket pair, initialize eventloop
   TCPMinnowSocket( std::pair<FileDescriptor, FileDescriptor> data_socket_pair, AdaptT&& datagram_interface );
 
@@ -124,7 +184,7 @@ class CS144TCPSocket : public TCPOverIPv4MinnowSocket
 {
 public:
   CS144TCPSocket() : TCPOverIPv4MinnowSocket( TCPOverIPv4OverTunFdAdapter { TunFD { "tun144" } } ) {}
-  void connect( const Address& address )
+  void connect( const Address& address, std::string early_data = {} )
   {
     TCPConfig tcp_config;
     tcp_config.rt_timeout = 100;
@@ -133,6 +193,6 @@ public:
     multiplexer_config.source = { "169.254.144.9", std::to_string( uint16_t( std::random_device()() ) ) };
     multiplexer_config.destination = address;
 
-    TCPOverIPv4MinnowSocket::connect( tcp_config, multiplexer_config );
+    TCPOverIPv4MinnowSocket::connect( tcp_config, multiplexer_config, std::move( early_data ) );
   }
 };
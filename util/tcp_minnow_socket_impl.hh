@@ -2,11 +2,18 @@
 
 #include "exception.hh"
 #include "parser.hh"
+#include "tcp_fastopen.hh"
+#include "tcp_metrics.hh"
 #include "tun.hh"
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <cstddef>
 #include <exception>
 #include <iostream>
+#include <pthread.h>
+#include <sched.h>
 #include <stdexcept>
 #include <string>
 #include <sys/socket.h>
@@ -15,7 +22,11 @@
 #include <unistd.h>
 #include <utility>
 
-static constexpr size_t TCP_TICK_MS = 10;
+//! poll() timeout for a deadline `due` ms away; with no deadline (nullopt), sleep until an event
+inline int poll_timeout_ms( std::optional<uint64_t> due )
+{
+  return due.has_value() ? static_cast<int>( std::min<uint64_t>( due.value(), INT_MAX ) ) : -1;
+}
 
 inline uint64_t timestamp_ms()
 {
@@ -30,7 +41,24 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
 {
   auto base_time = timestamp_ms();
   while ( condition() ) {
-    auto ret = _eventloop.wait_next_event( TCP_TICK_MS );
+    // 睡到下一个定时器到期（重传、pacing、cork、延迟 ACK、linger 等）；没有定时器就一直睡到有事件
+    // (a finished connection is no longer ticked, so its deadlines no longer apply)
+    int timeout_ms = _tcp.has_value() and _tcp->active() ? poll_timeout_ms( _tcp->ms_until_next_tick() ) : -1;
+    // With the shared-memory bridge, move bytes each way, and sleep only once a second look after arming the
+    // bridge finds nothing more to move (the owner's next write, close or read then wakes the loop)
+    bool moved = _bridge.has_value() and _tcp.has_value() and _pump_bridge();
+    // In busy-poll mode, spin for a while before arming the bridge and going to sleep
+    auto ret = EventLoop::Result::Timeout;
+    if ( _busy_poll.has_value() and not moved and timeout_ms != 0 ) {
+      ret = _spin();
+    }
+    if ( ret == EventLoop::Result::Timeout ) {
+      if ( _bridge.has_value() and _tcp.has_value() and not moved ) {
+        _bridge->thread().arm();
+        moved = _pump_bridge();
+      }
+      ret = _eventloop.wait_next_event( moved ? 0 : timeout_ms );
+    }
     if ( ret == EventLoop::Result::Exit or _abort ) {
       break;
     }
@@ -45,7 +73,43 @@ void TCPMinnowSocket<AdaptT>::_tcp_loop( const std::function<bool()>& condition
       _datagram_adapter.tick( next_time - base_time );
       base_time = next_time;
     }
+    _publish_info();
   }
+  _publish_info();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::_publish_info()
+{
+  if ( _tcp.has_value() ) {
+    const TCPInfo info = _tcp->info();
+    const std::lock_guard lock( _info_mutex );
+    _info = info;
+  }
+}
+
+template<TCPDatagramAdapter AdaptT>
+TCPInfo TCPMinnowSocket<AdaptT>::info() const
+{
+  const std::lock_guard lock( _info_mutex );
+  return _info;
+}
+
+//! Busy polling: look for events again and again until one is handled, or the spin budget runs out
+template<TCPDatagramAdapter AdaptT>
+EventLoop::Result TCPMinnowSocket<AdaptT>::_spin()
+{
+  const auto spin_end = std::chrono::steady_clock::now() + std::chrono::microseconds( _busy_poll->spin_us );
+  do {
+    const auto ret = _eventloop.wait_next_event( 0 );
+    if ( ret != EventLoop::Result::Timeout ) {
+      return ret;
+    }
+    if ( _bridge.has_value() and _tcp.has_value() and _pump_bridge() ) {
+      return EventLoop::Result::Success;
+    }
+  } while ( std::chrono::steady_clock::now() < spin_end and not _abort );
+  return EventLoop::Result::Timeout;
 }
 
 //! \param[in] data_socket_pair is a pair of connected AF_UNIX SOCK_STREAM sockets
@@ -66,6 +130,14 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
 {
   _tcp.emplace( config );
 
+  // the owner can wake the TCP thread (to abort), which otherwise sleeps until an event or a deadline
+  _eventloop.add_rule(
+    "wake the TCP thread",
+    _wakeup,
+    Direction::In,
+    [&] { _wakeup.clear(); },
+    [&] { return _tcp->active() or not _inbound_shutdown; } );
+
   // Set up the event loop
 
   // There are three events to handle:
@@ -86,12 +158,21 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     _datagram_adapter.fd(),
     Direction::In,
     [&] {
-      if ( auto seg = _datagram_adapter.read() ) {
-        _tcp->receive( std::move( seg.value() ), [&]( auto x ) { _datagram_adapter.write( x ); } );
+      for ( auto& seg : _datagram_adapter.read_all() ) {
+        // A connecting client's SYN: the adapter has learned its address, which its Fast Open cookie is bound to
+        // and under which earlier connections left their path measurements
+        if ( seg.sender.SYN and not seg.receiver.ackno.has_value() and not _tcp->has_ackno() ) {
+          const Address& client = _datagram_adapter.config().destination;
+          _tcp->issue_fastopen_cookie( fastopen_cookie_for( client ) );
+          if ( const auto metrics = cached_tcp_metrics( client ) ) {
+            _tcp->seed_metrics( metrics.value() );
+          }
+        }
+        _tcp->receive( std::move( seg ), [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
       // debugging output:
-      if ( _thread_data.eof() and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
+      if ( _outbound_shutdown and _tcp.value().sender().sequence_numbers_in_flight() == 0 and not _fully_acked ) {
         std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
                   << " has been fully acknowledged.\n";
         _fully_acked = true;
@@ -99,6 +180,17 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
     },
     [&] { return _tcp->active(); } );
 
+  // rules 2 and 3 with the shared-memory bridge: _tcp_loop moves the bytes, and this rule only wakes it
+  if ( _bridge.has_value() ) {
+    _eventloop.add_rule(
+      "shared-memory bridge to the owner",
+      _bridge->thread().fd(),
+      Direction::In,
+      [&] { _bridge->thread().clear(); },
+      [&] { return _tcp->active() or not _inbound_shutdown; } );
+    return;
+  }
+
   // rule 2: read from pipe into outbound buffer
   _eventloop.add_rule(
     "push bytes to TCPPeer",
@@ -150,6 +242,7 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
         const std::string_view buffer = inbound.peek();
         const auto bytes_written = _thread_data.write( buffer );
         inbound.pop( bytes_written );
+        _tcp->update_window( [&]( auto x ) { _datagram_adapter.write( x ); } );
       }
 
       if ( inbound.is_finished() or inbound.has_error() ) {
@@ -166,13 +259,64 @@ void TCPMinnowSocket<AdaptT>::_initialize_TCP( const TCPConfig& config )
              or ( ( _tcp->inbound_reader().is_finished() or _tcp->inbound_reader().has_error() )
                   and not _inbound_shutdown );
     },
-    [&] {},
+    [&] { _inbound_shutdown = true; },
     [&] {
       std::cerr << "DEBUG: minnow inbound stream had error.\n";
       _tcp->inbound_reader().set_error();
     } );
 }
 
+template<TCPDatagramAdapter AdaptT>
+bool TCPMinnowSocket<AdaptT>::_pump_bridge()
+{
+  SharedMemoryBridge::End& bridge = _bridge->thread();
+  bool moved = false;
+
+  // like rule 2: from the owner's ring into the outbound buffer
+  Writer& outbound = _tcp->outbound_writer();
+  if ( not _outbound_shutdown and outbound.available_capacity() > 0 and bridge.bytes_buffered() > 0 ) {
+    while ( outbound.available_capacity() > 0 and bridge.bytes_buffered() > 0 ) {
+      const std::string_view data = bridge.peek().substr( 0, outbound.available_capacity() );
+      outbound.push( std::string { data } );
+      bridge.pop( data.size() );
+    }
+    _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+    moved = true;
+  }
+  if ( not _outbound_shutdown and bridge.is_finished() ) {
+    outbound.close();
+    _outbound_shutdown = true;
+    _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
+    moved = true;
+
+    // debugging output:
+    std::cerr << "DEBUG: minnow outbound stream to " << _datagram_adapter.config().destination.to_string()
+              << " finished (" << _tcp.value().sender().sequence_numbers_in_flight() << " seqno"
+              << ( _tcp.value().sender().sequence_numbers_in_flight() == 1 ? "" : "s" ) << " still in flight).\n";
+  }
+
+  // like rule 3: from the inbound stream into the owner's ring
+  Reader& inbound = _tcp->inbound_reader();
+  if ( inbound.bytes_buffered() and bridge.available_capacity() > 0 ) {
+    while ( inbound.bytes_buffered() and bridge.available_capacity() > 0 ) {
+      inbound.pop( bridge.write( inbound.peek() ) );
+    }
+    _tcp->update_window( [&]( auto x ) { _datagram_adapter.write( x ); } );
+    moved = true;
+  }
+  if ( not _inbound_shutdown and ( inbound.is_finished() or inbound.has_error() ) ) {
+    bridge.close();
+    _inbound_shutdown = true;
+    moved = true;
+
+    // debugging output:
+    std::cerr << "DEBUG: minnow inbound stream from " << _datagram_adapter.config().destination.to_string()
+              << " finished " << ( inbound.has_error() ? "uncleanly.\n" : "cleanly.\n" );
+  }
+
+  return moved;
+}
+
 //! \brief Call [socketpair](\ref man2::socketpair) and return connected Unix-domain sockets of specified type
 //! \param[in] type is the type of AF_UNIX sockets to create (e.g., SOCK_SEQPACKET)
 //! \returns a std::pair of connected sockets
@@ -199,6 +343,7 @@ TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
       std::cerr << "Warning: unclean shutdown of TCPMinnowSocket\n";
       // force the other side to exit
       _abort.store( true );
+      _wakeup.notify();
       _tcp_thread.join();
     }
   } catch ( const std::exception& e ) {
@@ -206,10 +351,58 @@ TCPMinnowSocket<AdaptT>::~TCPMinnowSocket()
   }
 }
 
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::use_shared_memory( size_t capacity )
+{
+  if ( _tcp ) {
+    throw std::runtime_error( "use_shared_memory() after connect() or listen_and_accept()" );
+  }
+  _bridge.emplace( capacity );
+}
+
+template<TCPDatagramAdapter AdaptT>
+SharedMemoryBridge::End& TCPMinnowSocket<AdaptT>::shared_memory()
+{
+  if ( not _bridge.has_value() ) {
+    throw std::runtime_error( "shared_memory() without use_shared_memory()" );
+  }
+  return _bridge->owner();
+}
+
+template<TCPDatagramAdapter AdaptT>
+void TCPMinnowSocket<AdaptT>::set_busy_poll( const BusyPollConfig& config )
+{
+  if ( _tcp ) {
+    throw std::runtime_error( "set_busy_poll() after connect() or listen_and_accept()" );
+  }
+  if ( config.cpu.has_value() ) {
+    cpu_set_t allowed;
+    CPU_ZERO( &allowed );
+    CheckSystemCall( "sched_getaffinity", sched_getaffinity( 0, sizeof( allowed ), &allowed ) );
+    const int cpu = config.cpu.value();
+    if ( cpu < 0 or cpu >= CPU_SETSIZE or not CPU_ISSET( cpu, &allowed ) ) {
+      throw std::runtime_error( "set_busy_poll(): CPU " + std::to_string( cpu ) + " is not available" );
+    }
+  }
+  _busy_poll = config;
+}
+
 template<TCPDatagramAdapter AdaptT>
 void TCPMinnowSocket<AdaptT>::wait_until_closed()
 {
   shutdown( SHUT_RDWR );
+  if ( _bridge.has_value() and _tcp_thread.joinable() ) {
+    // the same for the bridge: nothing more goes out, and whatever still comes in is discarded
+    SharedMemoryBridge::End& bridge = _bridge->owner();
+    bridge.close();
+    while ( not bridge.is_finished() ) {
+      bridge.pop( bridge.bytes_buffered() );
+      bridge.arm();
+      if ( bridge.bytes_buffered() == 0 and not bridge.is_finished() ) {
+        bridge.wait();
+      }
+    }
+  }
   if ( _tcp_thread.joinable() ) {
     std::cerr << "DEBUG: minnow waiting for clean shutdown... ";
     _tcp_thread.join();
@@ -219,14 +412,22 @@ void TCPMinnowSocket<AdaptT>::wait_until_closed()
 
 //! \param[in] c_tcp is the TCPConfig for the TCPConnection
 //! \param[in] c_ad is the FdAdapterConfig for the FdAdapter
+//! \param[in] early_data is sent ahead of anything written later, on the SYN if a Fast Open cookie is cached
 template<TCPDatagramAdapter AdaptT>
-void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad )
+void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterConfig& c_ad, std::string early_data )
 {
   if ( _tcp ) {
     throw std::runtime_error( "connect() with TCPConnection already initialized" );
   }
 
-  _initialize_TCP( c_tcp );
+  TCPConfig config = c_tcp;
+  if ( config.fastopen and not config.fastopen_cookie.has_value() ) {
+    config.fastopen_cookie = cached_fastopen_cookie( c_ad.destination );
+  }
+  if ( not config.metrics.has_value() ) {
+    config.metrics = cached_tcp_metrics( c_ad.destination );
+  }
+  _initialize_TCP( config );
 
   _datagram_adapter.config_mut() = c_ad;
 
@@ -236,18 +437,25 @@ void TCPMinnowSocket<AdaptT>::connect( const TCPConfig& c_tcp, const FdAdapterCo
     throw std::runtime_error( "TCPPeer not successfully initialized" );
   }
 
+  if ( early_data.size() > _tcp->outbound_writer().available_capacity() ) {
+    throw std::runtime_error( "connect() with more early data than the send buffer holds" );
+  }
+  _tcp->outbound_writer().push( std::move( early_data ) );
   _tcp->push( [&]( auto x ) { _datagram_adapter.write( x ); } );
 
-  if ( _tcp->sender().sequence_numbers_in_flight() != 1 ) {
-    throw std::runtime_error( "After TCPConnection::connect(), expected sequence_numbers_in_flight() == 1" );
+  if ( not _tcp->sender().sequence_numbers_in_flight() ) {
+    throw std::runtime_error( "After TCPConnection::connect(), expected the SYN in flight" );
   }
 
-  _tcp_loop( [&] { return _tcp->sender().sequence_numbers_in_flight() == 1; } );
+  _tcp_loop( [&] { return not _tcp->has_ackno(); } );
   if ( _tcp->inbound_reader().has_error() ) {
     std::cerr << "DEBUG: minnow error on connecting to " << c_ad.destination.to_string() << ".\n";
   } else {
     std::cerr << "DEBUG: minnow successfully connected to " << c_ad.destination.to_string() << ".\n";
   }
+  if ( _tcp->received_fastopen_cookie().has_value() ) {
+    cache_fastopen_cookie( c_ad.destination, _tcp->received_fastopen_cookie().value() );
+  }
 
   _tcp_thread = std::thread( &TCPMinnowSocket::_tcp_main, this );
 }
@@ -280,8 +488,23 @@ void TCPMinnowSocket<AdaptT>::_tcp_main()
     if ( not _tcp.has_value() ) {
       throw std::runtime_error( "no TCP" );
     }
+    if ( _busy_poll.has_value() and _busy_poll->cpu.has_value() ) {
+      cpu_set_t cpu;
+      CPU_ZERO( &cpu );
+      CPU_SET( _busy_poll->cpu.value(), &cpu );
+      const int err = pthread_setaffinity_np( pthread_self(), sizeof( cpu ), &cpu );
+      if ( err != 0 ) {
+        throw unix_error( "pthread_setaffinity_np", err );
+      }
+    }
     _tcp_loop( [] { return true; } );
     shutdown( SHUT_RDWR );
+    if ( _bridge.has_value() and not _bridge->thread().is_closed() ) {
+      _bridge->thread().close();
+    }
+    if ( const auto metrics = _tcp->sender().metrics() ) {
+      cache_tcp_metrics( _datagram_adapter.config().destination, metrics.value() );
+    }
     if ( not _tcp.value().active() ) {
       std::cerr << "DEBUG: minnow TCP connection finished "
                 << ( _tcp->inbound_reader().has_error() ? "uncleanly.\n" : "cleanly.\n" );
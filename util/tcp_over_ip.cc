@@ -36,28 +36,23 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
     return {};
   }
 
-  // does the IPv4 datagram claim that its payload is a TCP segment?
-  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
-    return {};
-  }
-
   // is the payload a valid TCP segment?
-  TCPSegment tcp_seg;
-  if ( not parse( tcp_seg, ip_dgram.payload, ip_dgram.header.pseudo_checksum() ) ) {
+  auto tcp_seg = parse_tcp_in_ip( ip_dgram );
+  if ( not tcp_seg.has_value() ) {
     return {};
   }
 
   // is the TCP segment for us?
-  if ( tcp_seg.udinfo.dst_port != config().source.port() ) {
+  if ( tcp_seg->udinfo.dst_port != config().source.port() ) {
     return {};
   }
 
   // should we target this source addr/port (and use its destination addr as our source) in reply?
   if ( listening() ) {
-    if ( tcp_seg.message.sender.SYN and not tcp_seg.message.sender.RST ) {
+    if ( tcp_seg->message.sender.SYN and not tcp_seg->message.sender.RST ) {
       config_mutable().source = Address { inet_ntoa( { htobe32( ip_dgram.header.dst ) } ), config().source.port() };
       config_mutable().destination
-        = Address { inet_ntoa( { htobe32( ip_dgram.header.src ) } ), tcp_seg.udinfo.src_port };
+        = Address { inet_ntoa( { htobe32( ip_dgram.header.src ) } ), tcp_seg->udinfo.src_port };
       set_listening( false );
     } else {
       return {};
@@ -65,27 +60,60 @@ optional<TCPMessage> TCPOverIPv4Adapter::unwrap_tcp_in_ip( const InternetDatagra
   }
 
   // is the TCP segment from our peer?
-  if ( tcp_seg.udinfo.src_port != config().destination.port() ) {
+  if ( tcp_seg->udinfo.src_port != config().destination.port() ) {
     return {};
   }
 
-  return tcp_seg.message;
+  return tcp_seg->message;
+}
+
+optional<TCPSegment> TCPOverIPv4Adapter::parse_tcp_in_ip( const InternetDatagram& ip_dgram )
+{
+  // does the IPv4 datagram claim that its payload is a TCP segment?
+  if ( ip_dgram.header.proto != IPv4Header::PROTO_TCP ) {
+    return {};
+  }
+
+  // is the payload a valid TCP segment?
+  TCPSegment tcp_seg;
+  if ( not parse( tcp_seg, ip_dgram.payload, ip_dgram.header.pseudo_checksum() ) ) {
+    return {};
+  }
+
+  // the ECN codepoint is in the IP header, but it is the TCP receiver that has to echo a CE mark
+  tcp_seg.message.sender.ecn = ip_dgram.header.tos & IPv4Header::ECN_MASK;
+
+  return tcp_seg;
 }
 
 //! Takes a TCP segment, sets port numbers as necessary, and wraps it in an IPv4 datagram
 //! \param[in] seg is the TCP segment to convert
 InternetDatagram TCPOverIPv4Adapter::wrap_tcp_in_ip( const TCPMessage& msg )
+{
+  return make_tcp_in_ip( msg,
+                         config().source.ipv4_numeric(),
+                         config().source.port(),
+                         config().destination.ipv4_numeric(),
+                         config().destination.port() );
+}
+
+InternetDatagram TCPOverIPv4Adapter::make_tcp_in_ip( const TCPMessage& msg,
+                                                     uint32_t src_ip,
+                                                     uint16_t src_port,
+                                                     uint32_t dst_ip,
+                                                     uint16_t dst_port )
 {
   TCPSegment seg { .message = msg };
   // set the port numbers in the TCP segment
-  seg.udinfo.src_port = config().source.port();
-  seg.udinfo.dst_port = config().destination.port();
+  seg.udinfo.src_port = src_port;
+  seg.udinfo.dst_port = dst_port;
 
   // create an Internet Datagram and set its addresses and length
   InternetDatagram ip_dgram;
-  ip_dgram.header.src = config().source.ipv4_numeric();
-  ip_dgram.header.dst = config().destination.ipv4_numeric();
-  ip_dgram.header.len = ip_dgram.header.hlen * 4 + 20 /* tcp header len */ + seg.message.sender.payload.size();
+  ip_dgram.header.src = src_ip;
+  ip_dgram.header.dst = dst_ip;
+  ip_dgram.header.tos |= msg.sender.ecn & IPv4Header::ECN_MASK; // ECT if the sender made it ECN-capable
+  ip_dgram.header.len = ip_dgram.header.hlen * 4 + seg.header_length() + seg.message.sender.payload.size();
 
   // set payload, calculating TCP checksum using information from IP header
   seg.compute_checksum( ip_dgram.header.pseudo_checksum() );
@@ -4,6 +4,7 @@
 #include "ipv4_datagram.hh"
 #include "tcp_segment.hh"
 
+#include <cstdint>
 #include <optional>
 
 //! \brief A converter from TCP segments to serialized IPv4 datagrams
@@ -13,4 +14,14 @@ public:
   std::optional<TCPMessage> unwrap_tcp_in_ip( const InternetDatagram& ip_dgram );
 
   InternetDatagram wrap_tcp_in_ip( const TCPMessage& msg );
+
+  //! Parses the TCP segment in an IPv4 datagram (with the datagram's ECN codepoint), without any filtering
+  static std::optional<TCPSegment> parse_tcp_in_ip( const InternetDatagram& ip_dgram );
+
+  //! Wraps a TCP message in an IPv4 datagram between the given addresses and ports
+  static InternetDatagram make_tcp_in_ip( const TCPMessage& msg,
+                                          uint32_t src_ip,
+                                          uint16_t src_port,
+                                          uint32_t dst_ip,
+                                          uint16_t dst_port );
 };
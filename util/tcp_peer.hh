@@ -1,12 +1,15 @@
 #pragma once
 
+#include "ipv4_header.hh"
 #include "tcp_config.hh"
+#include "tcp_info.hh"
 #include "tcp_receiver.hh"
 #include "tcp_receiver_message.hh"
 #include "tcp_segment.hh"
 #include "tcp_sender.hh"
 #include "tcp_sender_message.hh"
 
+#include <algorithm>
 #include <functional>
 #include <optional>
 
@@ -18,7 +21,13 @@ class TCPPeer
   }
 
 public:
-  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg ) {}
+  explicit TCPPeer( const TCPConfig& cfg ) : cfg_( cfg )
+  {
+    sender_.configure( cfg_ );
+    if ( cfg_.receiver_sws_avoidance ) {
+      receiver_.set_sws_avoidance( cfg_.mss );
+    }
+  }
 
   Writer& outbound_writer() { return sender_.writer(); }
   Reader& inbound_reader() { return receiver_.reader(); }
@@ -32,9 +41,80 @@ public:
   {
     cumulative_time_ += t;
     sender_.tick( t, make_send( transmit ) );
+    autotune_receive_buffer();
+    update_window( transmit );
+
+    // Send a delayed ACK whose timer has expired.
+    if ( ack_due_ms_.has_value() and cumulative_time_ >= ack_due_ms_.value() ) {
+      send( sender_.make_empty_message(), transmit );
+    }
   }
+
+  /* How long until tick() next has work to do: a transmission the sender has scheduled (retransmission, pacing,
+   * cork, RACK, TLP or window probe), a delayed ACK, the end of lingering, or shrinking an idle auto-tuned
+   * receive buffer. With nothing scheduled (nullopt), the peer can sleep until a segment arrives. */
+  std::optional<uint64_t> ms_until_next_tick() const
+  {
+    std::optional<uint64_t> due = sender_.ms_until_next_transmission();
+    const auto consider = [&]( uint64_t deadline_ms ) {
+      const uint64_t ms { deadline_ms > cumulative_time_ ? deadline_ms - cumulative_time_ : 0 };
+      due = std::min( due.value_or( ms ), ms );
+    };
+
+    if ( ack_due_ms_.has_value() ) {
+      consider( ack_due_ms_.value() );
+    }
+    const bool streams_finished = receiver_.writer().is_closed() and sender_.reader().is_finished()
+                                  and sender_.sequence_numbers_in_flight() == 0;
+    if ( linger_after_streams_finish_ and streams_finished ) {
+      consider( time_of_last_receipt_ + 10UL * cfg_.rt_timeout );
+    }
+    // (the idle check repeats on every tick once it is due, so only a future one needs a wakeup)
+    const uint64_t idle_at = time_of_last_receipt_ + cfg_.recv_idle_ms;
+    if ( cfg_.recv_autotune and receiver_.reassembler().writer().capacity() > cfg_.recv_capacity
+         and idle_at > cumulative_time_ ) {
+      consider( idle_at );
+    }
+    return due;
+  }
+
   bool has_ackno() const { return receiver_.send().ackno.has_value(); }
 
+  /* Has the handshake completed (the peer's SYN received, and ours acknowledged)? */
+  bool established() const { return has_ackno() and sender_.SYN_acked(); }
+
+  /* TCP Fast Open, server side: the cookie the connecting client should present to have its SYN data
+   * accepted, and that is handed out on our SYN-ACK otherwise */
+  void issue_fastopen_cookie( std::string cookie ) { issued_cookie_ = std::move( cookie ); }
+
+  /* TCP Fast Open, client side: the cookie the server handed out on its SYN-ACK, for the next connection */
+  const std::optional<std::string>& received_fastopen_cookie() const { return received_cookie_; }
+
+  /* Start from what an earlier connection to the same destination measured (a server learns the destination
+   * only from the client's SYN, after construction) */
+  void seed_metrics( const TCPMetrics& metrics ) { sender_.seed( metrics ); }
+
+  /* Tell the peer about receive space the application has freed, if the window has (at least) doubled */
+  void update_window( const TransmitFunction& transmit )
+  {
+    if ( not active() or not has_ackno() or receiver_.writer().is_closed() ) {
+      return;
+    }
+    const uint64_t window = receiver_.send().window_size;
+    if ( window > last_window_sent_ and window >= 2 * last_window_sent_ ) {
+      send( sender_.make_empty_message(), transmit );
+    }
+  }
+
+  /* Cork the outbound stream (TCP_CORK): hold partial segments until uncorked or the cork timeout */
+  void set_cork( bool corked, const TransmitFunction& transmit )
+  {
+    sender_.set_cork( corked );
+    if ( not corked ) {
+      push( transmit );
+    }
+  }
+
   /* Is the peer still active? */
   bool active() const
   {
@@ -55,6 +135,7 @@ public:
 
     // Record time in case this peer has to linger after streams finish.
     time_of_last_receipt_ = cumulative_time_;
+    segments_in_ += wire_segments( msg.sender );
 
     // If SenderMessage occupies a sequence number, make sure to reply.
     need_send_ |= ( msg.sender.sequence_length() > 0 );
@@ -64,23 +145,112 @@ public:
     const auto our_ackno = receiver_.send().ackno;
     need_send_ |= ( our_ackno.has_value() and msg.sender.seqno + 1 == our_ackno.value() );
 
+    // Only in-order data without flags may have its ACK delayed.
+    const bool in_order_data = our_ackno.has_value() and msg.sender.seqno == our_ackno.value()
+                               and not msg.sender.SYN and not msg.sender.FIN and not msg.sender.RST
+                               and not msg.sender.payload.empty();
+    const uint64_t payload_size = msg.sender.payload.size();
+    const uint64_t wire_segment_size = msg.sender.gso_size ? msg.sender.gso_size : payload_size; // GRO-merged?
+    const Wrap32 segment_end = msg.sender.seqno + msg.sender.sequence_length();
+    const bool congestion_marked = ecn_ and msg.sender.ecn == IPv4Header::ECN_CE;
+
     // Did the inbound stream finish before the outbound stream? If so, no need to linger after streams finish.
-    if ( receiver_.writer().is_closed() and not sender_.reader().is_finished() ) {
+    if ( receiver_.writer().is_closed() and not sender_.FIN_sent() ) {
       linger_after_streams_finish_ = false;
     }
 
+    // The peer's SYN tells us the largest segment it is willing to receive (or a conservative default if not).
+    if ( msg.sender.SYN and not msg.sender.RST and not our_ackno.has_value() ) {
+      sender_.set_mss( std::min<uint64_t>( cfg_.mss, msg.sender.mss.value_or( TCPConfig::MAX_PAYLOAD_SIZE ) ) );
+    }
+
+    // ECN negotiation (RFC 3168): a SYN with ECE and CWR asks for ECN, a SYN-ACK with ECE alone agrees.
+    // On a SYN, these flags are not congestion signals.
+    if ( msg.sender.SYN and not msg.sender.RST ) {
+      const bool asks = msg.receiver.ECE and msg.sender.CWR and not msg.receiver.ackno.has_value();
+      const bool agrees = msg.receiver.ECE and not msg.sender.CWR and msg.receiver.ackno.has_value();
+      if ( ecn_capable() and ( asks or agrees ) ) {
+        ecn_ = true;
+        sender_.set_ecn( true );
+        receiver_.set_ecn( true );
+      }
+      msg.receiver.ECE = msg.sender.CWR = false;
+    }
+
+    // TCP Fast Open (RFC 7413): keep the cookie on a SYN-ACK; on a SYN, accept its data only with the cookie
+    // issued to this client (it is sent again once the handshake completes). A SYN without the option gets no
+    // way around the check; one that asks for a cookie, or presents a wrong one, is offered the cookie instead.
+    if ( msg.sender.SYN and not msg.sender.RST and cfg_.fastopen ) {
+      const std::optional<std::string>& cookie = msg.sender.fastopen_cookie;
+      if ( msg.receiver.ackno.has_value() ) {
+        if ( cookie.has_value() and not cookie->empty() ) {
+          received_cookie_ = cookie;
+        }
+      } else if ( not our_ackno.has_value() and ( issued_cookie_.empty() or cookie != issued_cookie_ ) ) {
+        msg.sender.payload.clear();
+        msg.sender.FIN = false;
+        offer_cookie_ = cookie.has_value() and not issued_cookie_.empty();
+      }
+    }
+
     // Give incoming TCPSenderMessage to receiver.
+    const bool pure_ack = msg.sender.sequence_length() == 0;
     receiver_.receive( std::move( msg.sender ) );
+    closed_by_peer_first_ |= receiver_.writer().is_closed() and not sender_.FIN_sent();
 
     // Give incoming TCPReceiverMessage to sender.
-    sender_.receive( msg.receiver );
+    sender_.receive( msg.receiver, pure_ack );
 
-    // Send reply if needed.
+    // Send whatever data is ready (the ACK may have opened the window or released data held back by Nagle).
+    // The first data segment carries our ACK, so a pure ACK is only needed if nothing could be sent.
+    push( transmit );
+
+    // Send reply if needed (unless it can wait: out-of-order segments, segments that leave or fill a hole, and
+    // segments marked CE, so the ECN-Echo reaches the sender quickly, get an immediate ACK).
     if ( need_send_ ) {
+      const bool hole = receiver_.reassembler().bytes_pending() > 0 or receiver_.send().ackno != segment_end;
+      if ( in_order_data and not hole and not congestion_marked and delay_ack( payload_size, wire_segment_size ) ) {
+        need_send_ = false;
+        return;
+      }
       send( sender_.make_empty_message(), transmit );
     }
   }
 
+  /* A snapshot of the connection's counters and state (like Linux's TCP_INFO). The counters are kept all the
+   * time, at the cost of a few additions per segment and per tick, so taking a snapshot is cheap. */
+  TCPInfo info() const
+  {
+    const RTTEstimator& rtt = sender_.rtt();
+    TCPInfo info;
+    info.state = state();
+    info.bytes_sent = sender_.bytes_sent();
+    info.bytes_retransmitted = sender_.bytes_retransmitted();
+    info.bytes_acked = sender_.reader().bytes_popped();
+    info.bytes_received = receiver_.writer().bytes_pushed();
+    info.bytes_in_flight = sender_.sequence_numbers_in_flight();
+    info.segments_out = segments_out_;
+    info.segments_in = segments_in_;
+    info.retransmissions = sender_.retransmissions();
+    info.duplicate_segments = receiver_.duplicate_segments();
+    info.out_of_order_segments = receiver_.out_of_order_segments();
+    info.spurious_timeouts = sender_.spurious_timeouts();
+    info.window_probes = sender_.window_probes();
+    info.srtt_ms = rtt.srtt_ms();
+    info.rttvar_ms = rtt.rttvar_ms();
+    info.min_rtt_ms = rtt.min_rtt_ms();
+    info.rto_ms = sender_.RTO_ms();
+    info.mss = sender_.mss();
+    info.cwnd = sender_.cwnd();
+    info.ssthresh = sender_.ssthresh() == UINT64_MAX ? 0 : sender_.ssthresh();
+    info.send_window = sender_.peer_window();
+    info.receive_window = last_window_sent_;
+    info.rwnd_limited_ms = sender_.rwnd_limited_ms();
+    info.cwnd_limited_ms = sender_.cwnd_limited_ms();
+    info.app_limited_ms = sender_.app_limited_ms();
+    return info;
+  }
+
   // Testing interface
   const TCPReceiver& receiver() const { return receiver_; }
   const TCPSender& sender() const { return sender_; }
@@ -91,12 +261,153 @@ private:
   TCPReceiver receiver_ { Reassembler { ByteStream { cfg_.recv_capacity } } };
 
   bool need_send_ {};
+  bool ecn_ {}; // ECN negotiated with the peer
+
+  // ECN is only offered when there is a congestion window to react to the peer's ECN-Echo
+  bool ecn_capable() const { return cfg_.ecn and cfg_.congestion_control; }
+  uint64_t last_window_sent_ {}; // window advertised on the last segment we sent
+
+  // TCP Fast Open
+  std::string issued_cookie_ {};                  // server: the valid cookie for the connecting client
+  bool offer_cookie_ {};                          // server: hand the cookie out on our SYN-ACK
+  std::optional<std::string> received_cookie_ {}; // client: the cookie the server handed out
+
+  // Delayed ACK: acknowledge every second full segment (or every stretch_ack_segments), else when the timer fires
+  std::optional<uint64_t> ack_due_ms_ {}; // when a delayed ACK must go out at the latest
+  uint64_t unacked_bytes_ {};             // in-order bytes received but not yet acknowledged
+  uint64_t rcv_mss_ {};                   // largest segment seen from the peer, i.e. a "full" segment
+  uint64_t quick_acks_left_ { cfg_.quick_ack_segments };
+
+  // Can the ACK for this segment wait? If so, schedule it and return true.
+  bool delay_ack( uint64_t payload_size, uint64_t wire_segment_size )
+  {
+    if ( not cfg_.delayed_ack ) {
+      return false;
+    }
+    rcv_mss_ = std::max( rcv_mss_, wire_segment_size );
+
+    // Early in the connection (the peer's slow start), ACK every segment so the peer can open up quickly.
+    if ( quick_acks_left_ > 0 ) {
+      quick_acks_left_--;
+      return false;
+    }
+
+    unacked_bytes_ += payload_size;
+    if ( unacked_bytes_ >= std::max<uint64_t>( 2, cfg_.stretch_ack_segments ) * rcv_mss_ ) {
+      return false;
+    }
+    if ( not ack_due_ms_.has_value() ) {
+      ack_due_ms_ = cumulative_time_ + cfg_.delayed_ack_ms;
+    }
+    return true;
+  }
+
+  // Receive buffer auto-tuning (dynamic right-sizing): once per RTT, make room for twice what the application
+  // read during that RTT, up to recv_capacity_max; shrink back to recv_capacity once the connection goes idle
+  // (without taking back the window already offered, see TCPReceiver::set_capacity).
+  // Without window scaling the peer can never be offered more than MAX_WINDOW, so a larger buffer would go unused.
+  uint64_t autotune_start_ms_ {}; // start of the current measurement interval
+  uint64_t autotune_popped_ {};   // bytes the application had read at its start
+
+  void autotune_receive_buffer()
+  {
+    if ( not cfg_.recv_autotune or not sender_.rtt().has_sample() ) {
+      return;
+    }
+
+    const Reader& reader = receiver_.reader();
+    const uint64_t capacity = receiver_.reassembler().writer().capacity();
+    if ( cumulative_time_ - time_of_last_receipt_ >= cfg_.recv_idle_ms ) {
+      if ( capacity > cfg_.recv_capacity and reader.bytes_buffered() == 0
+           and receiver_.reassembler().bytes_pending() == 0 ) {
+        receiver_.set_capacity( cfg_.recv_capacity );
+      }
+      autotune_start_ms_ = cumulative_time_;
+      autotune_popped_ = reader.bytes_popped();
+      return;
+    }
+
+    if ( cumulative_time_ - autotune_start_ms_ < std::max<uint64_t>( sender_.rtt().srtt_ms(), 1 ) ) {
+      return;
+    }
+    const uint64_t drained = reader.bytes_popped() - autotune_popped_;
+    const uint64_t wanted = std::min<uint64_t>( { 2 * drained, cfg_.recv_capacity_max, TCPConfig::MAX_WINDOW } );
+    if ( wanted > capacity ) {
+      receiver_.set_capacity( wanted );
+    }
+    autotune_start_ms_ = cumulative_time_;
+    autotune_popped_ = reader.bytes_popped();
+  }
 
   void send( const TCPSenderMessage& sender_message, const TransmitFunction& transmit )
   {
     TCPMessage msg { sender_message, receiver_.send() };
+    if ( msg.sender.SYN ) {
+      msg.sender.mss = cfg_.mss;
+      // Ask for ECN on our SYN; on our SYN-ACK, agree if the peer asked.
+      if ( ecn_capable() ) {
+        const bool syn_ack = msg.receiver.ackno.has_value();
+        msg.receiver.ECE = not syn_ack or ecn_;
+        msg.sender.CWR = not syn_ack;
+      }
+      // Present our cached Fast Open cookie on a SYN (an empty one asks for a cookie), or offer one on a SYN-ACK.
+      if ( cfg_.fastopen and not msg.receiver.ackno.has_value() ) {
+        msg.sender.fastopen_cookie = cfg_.fastopen_cookie.value_or( "" );
+      } else if ( offer_cookie_ ) {
+        msg.sender.fastopen_cookie = issued_cookie_;
+      }
+    }
+    receiver_.advertise( msg.receiver );
+    last_window_sent_ = msg.receiver.window_size;
+    segments_out_ += wire_segments( msg.sender );
     transmit( std::move( msg ) );
     need_send_ = false;
+    ack_due_ms_.reset(); // every outgoing segment carries the latest ACK
+    unacked_bytes_ = 0;
+  }
+
+  // Statistics (see info())
+  uint64_t segments_in_ {};
+  uint64_t segments_out_ {};
+  bool closed_by_peer_first_ {}; // the inbound stream finished before our FIN was sent
+
+  // How many segments a message is on the wire (a GSO or GRO super-segment is several)
+  static uint64_t wire_segments( const TCPSenderMessage& msg )
+  {
+    return msg.gso_size ? std::max<uint64_t>( ( msg.payload.size() + msg.gso_size - 1 ) / msg.gso_size, 1 ) : 1;
+  }
+
+  // The connection state, in RFC 9293's terms, from how far each stream has got
+  TCPInfo::State state() const
+  {
+    using State = TCPInfo::State;
+    if ( receiver_.reader().has_error() or sender_.writer().has_error() ) {
+      return State::reset;
+    }
+    if ( not active() ) {
+      return State::closed;
+    }
+    if ( not has_ackno() ) {
+      return sender_.SYN_sent() ? State::syn_sent : State::listen;
+    }
+    if ( not sender_.SYN_acked() ) {
+      return State::syn_received;
+    }
+
+    const bool fin_acked = sender_.FIN_sent() and sender_.sequence_numbers_in_flight() == 0;
+    if ( not receiver_.writer().is_closed() ) {
+      if ( not sender_.FIN_sent() ) {
+        return State::established;
+      }
+      return fin_acked ? State::fin_wait_2 : State::fin_wait_1;
+    }
+    if ( not sender_.FIN_sent() ) {
+      return State::close_wait;
+    }
+    if ( not fin_acked ) {
+      return closed_by_peer_first_ ? State::last_ack : State::closing;
+    }
+    return State::time_wait; // (still active, so lingering)
   }
 
   bool linger_after_streams_finish_ { true }; // one peer may need to linger to make sure all closure conditions met
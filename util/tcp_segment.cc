@@ -1,11 +1,20 @@
 #include "tcp_segment.hh"
 #include "checksum.hh"
+#include "tcp_config.hh"
 #include "wrapping_integers.hh"
 
 #include <cstddef>
 
 static constexpr uint32_t TCPHeaderMinLen = 5; // 32-bit words
 
+static constexpr uint8_t TCPOptionEnd = 0;
+static constexpr uint8_t TCPOptionNoOp = 1;
+static constexpr uint8_t TCPOptionMSS = 2;
+static constexpr uint8_t TCPOptionMSSLen = 4;
+static constexpr uint8_t TCPOptionFastOpen = 34; // RFC 7413; length 2 (no cookie) is a cookie request
+static constexpr uint8_t TCPOptionFastOpenMinCookie = 4;
+static constexpr uint8_t TCPOptionFastOpenMaxCookie = 16;
+
 using namespace std;
 
 void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum )
@@ -39,6 +48,8 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
     message.receiver.ackno.reset(); // no ACK
   }
 
+  message.sender.CWR = octet & 0b1000'0000;
+  message.receiver.ECE = octet & 0b0100'0000;
   message.sender.RST = message.receiver.RST = octet & 0b0000'0100;
   message.sender.SYN = octet & 0b0000'0010;
   message.sender.FIN = octet & 0b0000'0001;
@@ -47,11 +58,47 @@ void TCPSegment::parse( Parser& parser, uint32_t datagram_layer_pseudo_checksum
   parser.integer( udinfo.cksum );
   parser.integer( raw16 ); // urgent pointer
 
-  // skip any options or anything extra in the header
   if ( data_offset < TCPHeaderMinLen ) {
     parser.set_error();
+    return;
+  }
+
+  // parse the options we understand, and skip any others
+  uint32_t options_left = data_offset * 4 - TCPHeaderMinLen * 4;
+  while ( options_left > 0 and not parser.has_error() ) {
+    uint8_t kind {};
+    parser.integer( kind );
+    options_left--;
+
+    if ( kind == TCPOptionEnd ) {
+      break;
+    }
+    if ( kind == TCPOptionNoOp ) {
+      continue;
+    }
+
+    uint8_t len {};
+    parser.integer( len );
+    if ( len < 2 or len - 1U > options_left ) {
+      parser.set_error();
+      return;
+    }
+    options_left -= len - 1;
+
+    if ( kind == TCPOptionMSS and len == TCPOptionMSSLen ) {
+      message.sender.mss.emplace();
+      parser.integer( message.sender.mss.value() );
+    } else if ( kind == TCPOptionFastOpen
+                and ( len == 2
+                      or ( len - 2U >= TCPOptionFastOpenMinCookie and len - 2U <= TCPOptionFastOpenMaxCookie ) ) ) {
+      string cookie( len - 2, 0 );
+      parser.string( cookie );
+      message.sender.fastopen_cookie = std::move( cookie );
+    } else {
+      parser.remove_prefix( len - 2 );
+    }
   }
-  parser.remove_prefix( data_offset * 4 - TCPHeaderMinLen * 4 );
+  parser.remove_prefix( options_left );
 
   parser.all_remaining( message.sender.payload );
 }
@@ -68,17 +115,106 @@ void TCPSegment::serialize( Serializer& serializer ) const
   serializer.integer( udinfo.dst_port );
   serializer.integer( Wrap32Serializable { message.sender.seqno }.raw_value() );
   serializer.integer( Wrap32Serializable { message.receiver.ackno.value_or( Wrap32 { 0 } ) }.raw_value() );
-  serializer.integer( uint8_t { TCPHeaderMinLen << 4 } ); // data offset
+  serializer.integer( static_cast<uint8_t>( header_length() / 4 << 4 ) ); // data offset
   const bool reset = message.sender.RST or message.receiver.RST;
-  const uint8_t flags = ( message.receiver.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
+  const uint8_t flags = ( message.sender.CWR ? 0b1000'0000U : 0 ) | ( message.receiver.ECE ? 0b0100'0000U : 0 )
+                        | ( message.receiver.ackno.has_value() ? 0b0001'0000U : 0 ) | ( reset ? 0b0000'0100U : 0 )
                         | ( message.sender.SYN ? 0b0000'0010U : 0 ) | ( message.sender.FIN ? 0b0000'0001U : 0 );
   serializer.integer( flags );
   serializer.integer( message.receiver.window_size );
   serializer.integer( udinfo.cksum );
   serializer.integer( uint16_t { 0 } ); // urgent pointer
+
+  if ( message.sender.mss.has_value() ) {
+    serializer.integer( TCPOptionMSS );
+    serializer.integer( TCPOptionMSSLen );
+    serializer.integer( message.sender.mss.value() );
+  }
+  if ( message.sender.fastopen_cookie.has_value() ) {
+    serializer.integer( TCPOptionFastOpen );
+    serializer.integer( static_cast<uint8_t>( 2 + message.sender.fastopen_cookie->size() ) );
+    serializer.buffer( message.sender.fastopen_cookie.value() );
+  }
+  for ( uint32_t pad = options_length(); pad % 4 != 0; pad++ ) {
+    serializer.integer( TCPOptionNoOp );
+  }
+
   serializer.buffer( message.sender.payload );
 }
 
+uint32_t TCPSegment::options_length() const
+{
+  return ( message.sender.mss.has_value() ? TCPOptionMSSLen : 0 )
+         + ( message.sender.fastopen_cookie.has_value() ? 2 + message.sender.fastopen_cookie->size() : 0 );
+}
+
+uint32_t TCPSegment::header_length() const
+{
+  return TCPHeaderMinLen * 4 + ( options_length() + 3 ) / 4 * 4; // options are padded to a 32-bit boundary
+}
+
+vector<TCPMessage> split_gso( const TCPMessage& msg )
+{
+  const TCPSenderMessage& super = msg.sender;
+  if ( super.gso_size == 0 or super.payload.size() <= super.gso_size ) {
+    TCPMessage single = msg;
+    single.sender.gso_size = 0;
+    return { single };
+  }
+
+  vector<TCPMessage> pieces;
+  pieces.reserve( ( super.payload.size() + super.gso_size - 1 ) / super.gso_size );
+  for ( size_t offset = 0; offset < super.payload.size(); offset += super.gso_size ) {
+    const bool first = offset == 0;
+    const bool last = offset + super.gso_size >= super.payload.size();
+    TCPMessage piece { .sender = { .seqno = super.seqno + ( first ? 0 : super.SYN + offset ),
+                                   .SYN = super.SYN and first,
+                                   .payload = super.payload.substr( offset, super.gso_size ),
+                                   .FIN = super.FIN and last,
+                                   .RST = super.RST,
+                                   .CWR = super.CWR and first,
+                                   .mss = first ? super.mss : nullopt,
+                                   .fastopen_cookie = first ? super.fastopen_cookie : nullopt,
+                                   .ecn = super.ecn },
+                       .receiver = msg.receiver };
+    pieces.push_back( std::move( piece ) );
+  }
+  return pieces;
+}
+
+// Can `next` be appended to `prev` without losing anything the receiving peer would act on?
+static bool gro_mergeable( const TCPMessage& prev, const TCPMessage& next )
+{
+  const TCPSenderMessage& p = prev.sender;
+  const TCPSenderMessage& n = next.sender;
+  return not p.SYN and not p.FIN and not p.RST and not n.SYN and not n.RST and not p.mss and not n.mss
+         and not p.payload.empty() and not n.payload.empty() and n.seqno == p.seqno + p.payload.size()
+         and prev.receiver.ackno == next.receiver.ackno and prev.receiver.window_size == next.receiver.window_size
+         and not prev.receiver.RST and not next.receiver.RST
+         and not n.CWR and p.ecn == n.ecn and prev.receiver.ECE == next.receiver.ECE
+         and p.payload.size() + n.payload.size() <= TCPConfig::GSO_MAX_SIZE;
+}
+
+vector<TCPMessage> coalesce_gro( vector<TCPMessage> burst )
+{
+  vector<TCPMessage> merged;
+  merged.reserve( burst.size() );
+  for ( auto& msg : burst ) {
+    if ( merged.empty() or not gro_mergeable( merged.back(), msg ) ) {
+      merged.push_back( std::move( msg ) );
+      continue;
+    }
+
+    TCPSenderMessage& super = merged.back().sender;
+    if ( super.gso_size == 0 ) {
+      super.gso_size = super.payload.size();
+    }
+    super.payload += msg.sender.payload;
+    super.FIN = msg.sender.FIN;
+  }
+  return merged;
+}
+
 void TCPSegment::compute_checksum( uint32_t datagram_layer_pseudo_checksum )
 {
   udinfo.cksum = 0;
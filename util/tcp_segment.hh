@@ -5,6 +5,8 @@
 #include "tcp_sender_message.hh"
 #include "udinfo.hh"
 
+#include <vector>
+
 struct TCPMessage
 {
   TCPSenderMessage sender {};
@@ -20,4 +22,16 @@ struct TCPSegment
   void serialize( Serializer& serializer ) const;
 
   void compute_checksum( uint32_t datagram_layer_pseudo_checksum );
+
+  // Length of the TCP header, including any options, in bytes
+  uint32_t header_length() const;
+
+  // Length of the TCP options we carry, before padding, in bytes
+  uint32_t options_length() const;
 };
+
+// Cut a segmentation-offload super-segment into wire-sized messages (an ordinary message comes back as is)
+std::vector<TCPMessage> split_gso( const TCPMessage& msg );
+
+// Merge back-to-back, in-sequence data segments of a received burst into super-segments (receive offload)
+std::vector<TCPMessage> coalesce_gro( std::vector<TCPMessage> burst );
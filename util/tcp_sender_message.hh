@@ -2,12 +2,14 @@
 
 #include "wrapping_integers.hh"
 
+#include <cstdint>
+#include <optional>
 #include <string>
 
 /*
  * The TCPSenderMessage structure contains the information sent from a TCP sender to its receiver.
  *
- * It contains five fields:
+ * It contains ten fields. The first five make up every segment:
  *
  * 1) The sequence number (seqno) of the beginning of the segment. If the SYN flag is set, this is the
  *    sequence number of the SYN flag. Otherwise, it's the sequence number of the beginning of the payload.
@@ -20,6 +22,31 @@
  * 4) The FIN flag. If set, the payload represents the ending of the byte stream.
  *
  * 5) The RST (reset) flag. If set, the stream has suffered an error and the connection should be aborted.
+ *
+ * It may also carry TCP options that only make sense on a SYN:
+ *
+ * 6) The maximum segment size (MSS) option: the largest payload the sending peer is willing to receive
+ *    in one segment. Absent if the peer did not announce one.
+ *
+ * 7) The TCP Fast Open (TFO) cookie option (RFC 7413). On a SYN, an empty cookie asks the server for one and
+ *    a nonempty cookie asks it to accept the data carried on the SYN; on a SYN-ACK, it is the cookie the
+ *    server hands out for the client's next connections. Absent if not used.
+ *
+ * And a flag for explicit congestion notification (ECN):
+ *
+ * 8) The CWR (congestion window reduced) flag. If set, the sender has slowed down in response to an ECN-Echo
+ *    and the receiver can stop echoing (on a SYN, together with ECE, it asks to use ECN).
+ *
+ * And two fields that never appear in the TCP header:
+ *
+ * 9) The segmentation offload size (gso_size). If nonzero, this is a "super-segment" whose payload is
+ *    longer than one wire segment: on the way out, the adapter cuts it into segments of gso_size bytes
+ *    (see split_gso); on the way in, it is several received segments of (up to) gso_size bytes merged
+ *    into one (see coalesce_gro).
+ *
+ * 10) The ECN codepoint of the IP datagram carrying the segment (IPv4Header::ECN_*). On the way out, the
+ *     adapter copies it into the datagram (ECT marks it as ECN-capable); on the way in, it is the codepoint
+ *     as received, so CE means a router on the path saw congestion.
  */
 
 struct TCPSenderMessage
@@ -31,6 +58,13 @@ struct TCPSenderMessage
   bool FIN {};
 
   bool RST {};
+  bool CWR {};
+
+  std::optional<uint16_t> mss {};
+  std::optional<std::string> fastopen_cookie {};
+
+  uint16_t gso_size {};
+  uint8_t ecn {};
 
   // How many sequence numbers does this segment use?
   size_t sequence_length() const { return SYN + payload.size() + FIN; }
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "address.hh"
+#include "eventfd.hh"
+#include "eventloop.hh"
+#include "ipv4_datagram.hh"
+#include "spsc_queue.hh"
+#include "tcp_config.hh"
+#include "tcp_connection_manager.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! \brief A thread-per-core TCP stack
+//!
+//! The stack is split into shards, each a worker thread with its own event loop, TCPConnectionManager (and
+//! so its own connection table, buffers and timers) and inbox. Incoming datagrams are steered to a shard by a
+//! hash of their 4-tuple, the way a NIC's receive-side scaling spreads flows over queues, so every segment of
+//! a connection is handled by the same thread; the application runs on the shards too (see ShardTask), and
+//! nothing but the inboxes is shared between threads.
+class TCPShardedStack
+{
+public:
+  static constexpr size_t INBOX_CAPACITY = 4096; //!< Datagrams a shard's inbox holds; more are dropped
+
+  class Shard
+  {
+  public:
+    Shard( size_t index, size_t shards, const TCPConfig& cfg );
+
+    //! Position of this shard in the stack
+    size_t index() const { return index_; }
+
+    //! This shard's connections
+    TCPConnectionManager& manager() { return manager_; }
+
+    //! This shard's event loop (the application can add its own rules to it)
+    EventLoop& eventloop() { return eventloop_; }
+
+    //! Open a connection from `local_ip` to `remote`, on a local port chosen so that the connection's
+    //! 4-tuple hashes to this shard (and the replies are steered back here); throws if no port is left
+    FourTuple connect( const std::string& local_ip, const Address& remote );
+
+  private:
+    friend class TCPShardedStack;
+
+    size_t index_;
+    size_t shards_;
+    TCPConnectionManager manager_;
+    EventLoop eventloop_ {};
+    SPSCQueue<InternetDatagram> inbox_ { INBOX_CAPACITY };
+    EventFD wakeup_ {};            //!< eventfd the producer writes when the shard is asleep
+    std::atomic_bool sleeping_ {}; //!< Is the shard (about to be) blocked in its event loop?
+    uint16_t next_port_;           //!< Where the search for an ephemeral port starts
+    std::thread thread_ {};
+  };
+
+  //! The application's work on a shard, run on the shard's thread after each round of incoming datagrams
+  //! and timers (to accept connections, read and write their streams, and call push() and update_window())
+  using ShardTask = std::function<void( Shard& )>;
+
+  //! Where the shards' outgoing datagrams go; called on the sending shard's thread
+  using Output = std::function<void( Shard&, InternetDatagram&& )>;
+
+  //! Construct `shards` shards, each serving connections with configuration `cfg`
+  TCPShardedStack( size_t shards, const TCPConfig& cfg, Output output, ShardTask task );
+
+  //! Accept connections to `port` on every shard (call before start())
+  void listen( uint16_t port,
+               size_t syn_backlog = TCPConnectionManager::DEFAULT_BACKLOG,
+               size_t accept_backlog = TCPConnectionManager::DEFAULT_BACKLOG );
+
+  //! Start the shards' threads
+  void start();
+
+  //! Steer an incoming datagram to the inbox of its shard. The inboxes have one producer each, so all calls
+  //! must come from the same thread (e.g. the one reading the TUN device). A datagram that finds its
+  //! inbox full is dropped, as a NIC drops on a full receive ring.
+  void deliver( InternetDatagram&& dgram );
+
+  //! The shard that handles a 4-tuple (seen from the local end)
+  size_t shard_for( const FourTuple& id ) const { return FourTupleHash {}( id ) % shards_.size(); }
+
+  //! The shard that handles an incoming datagram (non-TCP datagrams go to shard 0)
+  size_t shard_for( const InternetDatagram& dgram ) const;
+
+  //! Number of shards
+  size_t size() const { return shards_.size(); }
+
+  //! Stop and join the shards' threads; connections still open are dropped
+  ~TCPShardedStack();
+
+  //! \name
+  //! This object cannot be safely moved or copied, since it is in use by several threads simultaneously
+
+  //!@{
+  TCPShardedStack( const TCPShardedStack& ) = delete;
+  TCPShardedStack( TCPShardedStack&& ) = delete;
+  TCPShardedStack& operator=( const TCPShardedStack& ) = delete;
+  TCPShardedStack& operator=( TCPShardedStack&& ) = delete;
+  //!@}
+
+private:
+  std::vector<std::unique_ptr<Shard>> shards_ {};
+  Output output_;
+  ShardTask task_;
+  std::atomic_bool stop_ {};
+
+  void run( Shard& shard );
+};
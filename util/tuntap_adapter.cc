@@ -3,18 +3,55 @@
 
 using namespace std;
 
-optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
+bool TCPOverIPv4OverTunFdAdapter::read_datagram( optional<TCPMessage>& msg )
 {
+  msg.reset();
+
   vector<string> strs( 2 );
   strs.front().resize( IPv4Header::LENGTH );
   _tun.read( strs );
+  if ( strs.empty() ) {
+    return false; // nothing waiting on the (non-blocking) device
+  }
 
   InternetDatagram ip_dgram;
   const vector<string> buffers = { strs.at( 0 ), strs.at( 1 ) };
   if ( parse( ip_dgram, buffers ) ) {
-    return unwrap_tcp_in_ip( ip_dgram );
+    msg = unwrap_tcp_in_ip( ip_dgram );
+  }
+  return true;
+}
+
+optional<TCPMessage> TCPOverIPv4OverTunFdAdapter::read()
+{
+  optional<TCPMessage> msg;
+  read_datagram( msg );
+  return msg;
+}
+
+vector<TCPMessage> TCPOverIPv4OverTunFdAdapter::read_burst()
+{
+  vector<TCPMessage> burst;
+  optional<TCPMessage> msg;
+  for ( size_t i = 0; i < GRO_MAX_BURST and read_datagram( msg ); i++ ) {
+    if ( msg.has_value() ) {
+      burst.push_back( std::move( msg.value() ) );
+    }
+  }
+  return burst;
+}
+
+void TCPOverIPv4OverTunFdAdapter::write( const TCPMessage& seg )
+{
+  if ( seg.sender.gso_size == 0 ) {
+    _tun.write( serialize( wrap_tcp_in_ip( seg ) ) );
+    return;
+  }
+
+  // Software segmentation offload: everything above this point handled the burst as one segment
+  for ( const auto& piece : split_gso( seg ) ) {
+    _tun.write( serialize( wrap_tcp_in_ip( piece ) ) );
   }
-  return {};
 }
 
 //! Specialize LossyFdAdapter to TCPOverIPv4OverTunFdAdapter
@@ -4,15 +4,19 @@
 #include "tcp_segment.hh"
 #include "tun.hh"
 
+#include <cstddef>
 #include <optional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 template<class T>
 concept TCPDatagramAdapter = requires( T a, TCPMessage seg ) {
   { a.write( seg ) } -> std::same_as<void>;
 
   { a.read() } -> std::same_as<std::optional<TCPMessage>>;
+
+  { a.read_all() } -> std::same_as<std::vector<TCPMessage>>;
 };
 
 //! \brief A FD adapter for IPv4 datagrams read from and written to a TUN device
@@ -21,15 +25,27 @@ class TCPOverIPv4OverTunFdAdapter : public TCPOverIPv4Adapter
 private:
   TunFD _tun;
 
+  //! Reads one datagram into `msg` (empty if unrelated or invalid); returns false if none was waiting
+  bool read_datagram( std::optional<TCPMessage>& msg );
+
 public:
-  //! Construct from a TunFD
-  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) {}
+  static constexpr size_t GRO_MAX_BURST = 64; //!< Most datagrams drained from the device on one wakeup
+
+  //! Construct from a TunFD (reads are non-blocking, so that a burst can be drained without waiting)
+  explicit TCPOverIPv4OverTunFdAdapter( TunFD&& tun ) : _tun( std::move( tun ) ) { _tun.set_blocking( false ); }
 
   //! Attempts to read and parse an IPv4 datagram containing a TCP segment related to the current connection
   std::optional<TCPMessage> read();
 
+  //! Reads every datagram waiting on the device (up to GRO_MAX_BURST), without coalescing them
+  std::vector<TCPMessage> read_burst();
+
+  //! Reads every datagram waiting on the device, merging back-to-back segments (see coalesce_gro)
+  std::vector<TCPMessage> read_all() { return coalesce_gro( read_burst() ); }
+
   //! Creates an IPv4 datagram from a TCP segment and writes it to the TUN device
-  void write( const TCPMessage& seg ) { _tun.write( serialize( wrap_tcp_in_ip( seg ) ) ); }
+  //! (a GSO super-segment becomes one datagram per wire segment)
+  void write( const TCPMessage& seg );
 
   //! Access the underlying TUN device
   explicit operator TunFD&() { return _tun; }